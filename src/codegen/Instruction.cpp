@@ -12,6 +12,7 @@ std::string toString(Types t) {
   if(t == Types::CHAR_STAR) return "char*";
   if(t == Types::CONST_CHAR_STAR) return "const char*";
   if(t == Types::LONG) return "long";
+  if(t == Types::LONG_STAR) return "long*";
   if(t == Types::INT) return "int";
   return "<unknown>";
 }
@@ -33,6 +34,7 @@ std::string toString(X86Register reg, Types t) {
         case Types::CHAR_STAR: return "rdi";
         case Types::CONST_CHAR_STAR: return "rdi";
         case Types::LONG: return "rdi";
+        case Types::LONG_STAR: return "rdi";
         case Types::INT: return "edi";
       }
     case X86Register::SI:
@@ -41,6 +43,7 @@ std::string toString(X86Register reg, Types t) {
         case Types::CHAR_STAR: return "rsi";
         case Types::CONST_CHAR_STAR: return "rsi";
         case Types::LONG: return "rsi";
+        case Types::LONG_STAR: return "rsi";
         case Types::INT: return "esi";
       }
     case X86Register::D:
@@ -49,6 +52,7 @@ std::string toString(X86Register reg, Types t) {
         case Types::CHAR_STAR: return "rdx";
         case Types::CONST_CHAR_STAR: return "rdx";
         case Types::LONG: return "rdx";
+        case Types::LONG_STAR: return "rdx";
         case Types::INT: return "edx";
       }
     case X86Register::A:
@@ -57,6 +61,7 @@ std::string toString(X86Register reg, Types t) {
         case Types::CHAR_STAR: return "rax";
         case Types::CONST_CHAR_STAR: return "rax";
         case Types::LONG: return "rax";
+        case Types::LONG_STAR: return "rax";
         case Types::INT: return "eax";
       }
     case X86Register::C:
@@ -65,8 +70,21 @@ std::string toString(X86Register reg, Types t) {
         case Types::CHAR_STAR: return "rcx";
         case Types::CONST_CHAR_STAR: return "rcx";
         case Types::LONG: return "rcx";
+        case Types::LONG_STAR: return "rcx";
         case Types::INT: return "ecx";
       }
+    case X86Register::R8:
+    case X86Register::R9:
+    case X86Register::R10:
+    case X86Register::R11: {
+      std::string r =
+          "r" + std::to_string(8 + int(reg) - int(X86Register::R8));
+      switch(t) {
+        case Types::CHAR: return r + "b";
+        case Types::INT: return r + "d";
+        default: return r;
+      }
+    }
     default: return "<unknown>";
   }
 }
@@ -91,8 +109,206 @@ std::string loadSizeForType(Types loadType) {
   return "<unknown>";
 }
 
+// x86-64 encoding, only the forms the instructions above use
+
+using Bytes = std::vector<unsigned char>;
+
+static uint8_t regNumber(X86Register reg) {
+  switch(reg) {
+    case X86Register::A: return 0;
+    case X86Register::C: return 1;
+    case X86Register::D: return 2;
+    case X86Register::SI: return 6;
+    case X86Register::DI: return 7;
+    case X86Register::R8: return 8;
+    case X86Register::R9: return 9;
+    case X86Register::R10: return 10;
+    case X86Register::R11: return 11;
+    default: assert(false && "variable has no register"); return 0;
+  }
+}
+static bool isWide(Types t) { return t != Types::CHAR && t != Types::INT; }
+// without a rex prefix, byte registers 4-7 are ah, ch, dh and bh instead of
+// spl, bpl, sil and dil
+static bool needsRexAsByte(uint8_t r) { return r >= 4 && r < 8; }
+
+static void emitRex(
+    Bytes& out,
+    bool wide,
+    uint8_t reg,
+    uint8_t index,
+    uint8_t base,
+    bool force) {
+  uint8_t rex = 0x40 | (wide ? 8 : 0) | ((reg & 8) >> 1) | ((index & 8) >> 2) |
+                ((base & 8) >> 3);
+  if(rex != 0x40 || force) out.push_back(rex);
+}
+static void emitImm32(Bytes& out, uint32_t imm) {
+  for(int i = 0; i < 4; i++)
+    out.push_back(uint8_t(imm >> (8 * i)));
+}
+static bool fitsImm8(long long imm) { return imm >= -128 && imm <= 127; }
+static bool fitsImm32(long long imm) {
+  return imm >= INT32_MIN && imm <= INT32_MAX;
+}
+
+// `op reg, rm` with both operands registers. `opcode` is the wide form, the
+// byte form of add, sub, cmp, xor and mov is the same with the low bit clear
+static void emitRR(
+    Bytes& out,
+    Bytes opcode,
+    Types type,
+    uint8_t reg,
+    uint8_t rm) {
+  bool byte = type == Types::CHAR;
+  if(byte) opcode.back() &= uint8_t(~1);
+  emitRex(
+      out,
+      isWide(type),
+      reg,
+      0,
+      rm,
+      byte && (needsRexAsByte(reg) || needsRexAsByte(rm)));
+  out.insert(out.end(), opcode.begin(), opcode.end());
+  out.push_back(uint8_t(0xC0 | (reg & 7) << 3 | (rm & 7)));
+}
+// `op reg, [base + index]`, `index` < 0 for none
+static void emitRM(
+    Bytes& out,
+    Bytes opcode,
+    bool wide,
+    bool byteReg,
+    uint8_t reg,
+    uint8_t base,
+    int index) {
+  assert(index != 4 && "rsp can't be an index");
+  uint8_t idx = index < 0 ? 0 : uint8_t(index);
+  emitRex(out, wide, reg, idx, base, byteReg && needsRexAsByte(reg));
+  out.insert(out.end(), opcode.begin(), opcode.end());
+  // rbp and r13 as a base need a displacement, rsp and r12 need a sib byte
+  bool disp8 = (base & 7) == 5;
+  uint8_t mod = disp8 ? 0x40 : 0x00;
+  if(index >= 0 || (base & 7) == 4) {
+    out.push_back(uint8_t(mod | (reg & 7) << 3 | 4));
+    out.push_back(uint8_t((index < 0 ? 4 : (idx & 7)) << 3 | (base & 7)));
+  } else {
+    out.push_back(uint8_t(mod | (reg & 7) << 3 | (base & 7)));
+  }
+  if(disp8) out.push_back(0);
+}
+// the immediate forms of add, sub and cmp, `ext` picks which
+static void emitArithImm(
+    Bytes& out,
+    uint8_t ext,
+    Types type,
+    uint8_t rm,
+    long long imm) {
+  bool byte = type == Types::CHAR;
+  emitRex(out, isWide(type), 0, 0, rm, byte && needsRexAsByte(rm));
+  if(byte) out.push_back(0x80);
+  else out.push_back(fitsImm8(imm) ? 0x83 : 0x81);
+  out.push_back(uint8_t(0xC0 | ext << 3 | (rm & 7)));
+  if(byte || fitsImm8(imm)) out.push_back(uint8_t(imm));
+  else emitImm32(out, uint32_t(imm));
+}
+static void emitMovImm(Bytes& out, Types type, uint8_t reg, long long imm) {
+  if(type == Types::CHAR) {
+    emitRex(out, false, 0, 0, reg, needsRexAsByte(reg));
+    out.push_back(uint8_t(0xB0 + (reg & 7)));
+    out.push_back(uint8_t(imm));
+  } else if(!isWide(type) || fitsImm32(imm)) {
+    // mov r/m64, imm32 sign extends
+    emitRex(out, isWide(type), 0, 0, reg, false);
+    out.push_back(0xC7);
+    out.push_back(uint8_t(0xC0 | (reg & 7)));
+    emitImm32(out, uint32_t(imm));
+  } else {
+    emitRex(out, true, 0, 0, reg, false);
+    out.push_back(uint8_t(0xB8 + (reg & 7)));
+    for(int i = 0; i < 8; i++)
+      out.push_back(uint8_t(uint64_t(imm) >> (8 * i)));
+  }
+}
+static uint8_t conditionNibble(ConditionCode cc) {
+  switch(cc) {
+    case ConditionCode::EQ: return 0x4;
+    case ConditionCode::NEQ: return 0x5;
+    case ConditionCode::LT: return 0xC;
+    case ConditionCode::GTEQ: return 0xD;
+    case ConditionCode::LTEQ: return 0xE;
+    case ConditionCode::GT: return 0xF;
+  }
+  return 0;
+}
+
+std::vector<unsigned char> Load::toBytes() {
+  assert(!offset->isImmediate());
+  Bytes out;
+  uint8_t reg = regNumber(dest->reg);
+  uint8_t base = regNumber(this->base->reg);
+  int index = regNumber(offset->reg);
+  // mov r8, byte [...] or movzx r32, byte [...], which clears the top too
+  if(dest->type == loadType)
+    emitRM(out, {0x8A}, false, true, reg, base, index);
+  else emitRM(out, {0x0F, 0xB6}, false, false, reg, base, index);
+  return out;
+}
+std::vector<unsigned char> Add::toBytes() {
+  Bytes out;
+  if(op1->isImmediate())
+    emitArithImm(out, 0, dest->type, regNumber(dest->reg), op1->initialValue);
+  else
+    emitRR(out, {0x01}, dest->type, regNumber(op1->reg), regNumber(dest->reg));
+  return out;
+}
+std::vector<unsigned char> Sub::toBytes() {
+  Bytes out;
+  if(op1->isImmediate())
+    emitArithImm(out, 5, dest->type, regNumber(dest->reg), op1->initialValue);
+  else
+    emitRR(out, {0x29}, dest->type, regNumber(op1->reg), regNumber(dest->reg));
+  return out;
+}
+std::vector<unsigned char> Jump::toBytes() { return {0xE9, 0, 0, 0, 0}; }
+std::vector<unsigned char> ConditionalJump::toBytes() {
+  Bytes out;
+  uint8_t l = regNumber(lhs->reg);
+  if(rhs->isImmediate()) emitArithImm(out, 7, lhs->type, l, rhs->initialValue);
+  else emitRR(out, {0x39}, lhs->type, regNumber(rhs->reg), l);
+  Bytes jcc = {0x0F, uint8_t(0x80 | conditionNibble(cc)), 0, 0, 0, 0};
+  out.insert(out.end(), jcc.begin(), jcc.end());
+  return out;
+}
+std::vector<unsigned char> Copy::toBytes() {
+  Bytes out;
+  uint8_t d = regNumber(dest->reg);
+  if(source->isImmediate())
+    emitMovImm(out, dest->type, d, (long long)source->initialValue);
+  else emitRR(out, {0x89}, dest->type, regNumber(source->reg), d);
+  return out;
+}
+std::vector<unsigned char> Store::toBytes() {
+  Bytes out;
+  uint8_t base = regNumber(address->reg);
+  if(source->isImmediate()) {
+    emitRM(out, {0xC7}, true, false, 0, base, -1);
+    emitImm32(out, uint32_t(source->initialValue));
+  } else {
+    emitRM(out, {0x89}, true, false, regNumber(source->reg), base, -1);
+  }
+  return out;
+}
+std::vector<unsigned char> Return::toBytes() { return {0xC3}; }
+
+void CompiledRegex::numberInstructions() {
+  size_t id = 0;
+  for(auto i : func.instructions)
+    i->id = id++;
+}
+
 std::string CompiledRegex::toNasm(std::string name) {
 
+  numberInstructions();
   std::stringstream ss;
 
   ss << "bits 64\n";
@@ -104,7 +320,7 @@ std::string CompiledRegex::toNasm(std::string name) {
 
   // variable init
   for(auto& p : func.variables) {
-    if(p->isLocal() && p->hasInitialValue()) {
+    if(p && p->isLocal() && p->hasInitialValue()) {
       auto val = p->initialValue;
       // if zero, do an xor of the 32 bit version
       if(val == 0) {
@@ -125,6 +341,37 @@ std::string CompiledRegex::toNasm(std::string name) {
   return ss.str();
 }
 
+std::vector<unsigned char> CompiledRegex::toBytes() {
+  numberInstructions();
+  Bytes code;
+
+  // variable init, as in toNasm
+  for(auto& p : func.variables) {
+    if(p && p->isLocal() && p->hasInitialValue()) {
+      auto reg = regNumber(p->reg);
+      if(p->initialValue == 0) emitRR(code, {0x31}, Types::INT, reg, reg);
+      else emitMovImm(code, p->type, reg, (long long)p->initialValue);
+    }
+  }
+
+  // jumps are patched once every instruction has an offset, the
+  // displacement is from the end of the jump
+  std::vector<size_t> offsets;
+  std::vector<std::pair<size_t, Instruction*>> jumps;
+  for(auto i : func.instructions) {
+    offsets.push_back(code.size());
+    auto bytes = i->toBytes();
+    code.insert(code.end(), bytes.begin(), bytes.end());
+    if(auto target = i->jumpTarget()) jumps.push_back({code.size(), target});
+  }
+  for(const auto& [end, target] : jumps) {
+    auto rel = uint32_t(int32_t(offsets[target->id]) - int32_t(end));
+    for(int b = 0; b < 4; b++)
+      code[end - 4 + b] = uint8_t(rel >> (8 * b));
+  }
+  return code;
+}
+
 template <size_t Parameters, size_t Locals>
 std::string Function<Parameters, Locals>::signature(std::string name) {
   std::stringstream ss;
@@ -132,7 +379,7 @@ std::string Function<Parameters, Locals>::signature(std::string name) {
   ss << toString(retType) << " " << name << "(";
   std::string sep;
   for(auto& p : variables) {
-    if(p->isParameter()) {
+    if(p && p->isParameter()) {
       ss << sep << toString(p->type) << " " << p->name;
       sep = ", ";
     }
@@ -143,17 +390,37 @@ std::string Function<Parameters, Locals>::signature(std::string name) {
 
 std::string CompiledRegex::toHeader(std::string name) {
   std::string ret = func.signature(name) + ";";
+  if(reportsPatterns()) {
+    ret += "\nextern const long* const " + name + "_sets[];";
+    ret += "\nextern const long " + name + "_nSets;";
+  }
   return ret;
 }
+std::string CompiledRegex::toPatternSets(std::string name) {
+  std::stringstream ss;
+  for(size_t i = 0; i < patternSets_.size(); i++) {
+    ss << "static const long " << name << "_set" << i << "[] = {";
+    for(auto p : patternSets_[i])
+      ss << p << ", ";
+    ss << "-1};\n";
+  }
+  ss << "const long* const " << name << "_sets[] = {\n";
+  for(size_t i = 0; i < patternSets_.size(); i++)
+    ss << name << "_set" << i << ",\n";
+  ss << "};\n";
+  ss << "const long " << name << "_nSets = " << patternSets_.size() << ";";
+  return ss.str();
+}
 std::string CompiledRegex::toC(std::string name) {
 
+  numberInstructions();
   std::stringstream ss;
 
   ss << func.signature(name) << " {\n";
 
   // variable init
   for(auto& p : func.variables) {
-    if(p->isLocal()) {
+    if(p && p->isLocal()) {
       ss << "  " << toString(p->type) << " " << p->name;
       if(p->hasInitialValue()) ss << " = " << p->getInitialValue();
       ss << ";\n";
@@ -169,12 +436,36 @@ std::string CompiledRegex::toC(std::string name) {
 }
 
 // we can prob make this unique ptr?
-InstructionList* CompiledRegex::getNewBlockForState(State* state) {
+InstructionList* CompiledRegex::getNewBlockForState(size_t state) {
   InstructionList* il = new InstructionList();
 
   // first state is a nop
   il->addBack(new NOP());
 
+  if(mode_ == MatchMode::Reverse) {
+    // check for i <= 0
+    ConditionalJump* cjmp = new ConditionalJump;
+    cjmp->lhs = counter_().get();
+    cjmp->rhs = Variable::buildImmediate(Types::LONG, 0);
+    cjmp->cc = ConditionCode::LTEQ;
+    cjmp->target = doneState;
+    il->addBack(cjmp);
+
+    // dec counter, then read the char before it
+    Sub* sub = new Sub;
+    sub->dest = counter_().get();
+    sub->op1 = Variable::buildImmediate(Types::LONG, 1);
+    il->addBack(sub);
+
+    Load* load = new Load;
+    load->base = input_().get();
+    load->offset = counter_().get();
+    load->loadType = Types::CHAR;
+    load->dest = next_().get();
+    il->addBack(load);
+    return il;
+  }
+
   // check for i >= n
   ConditionalJump* cjmp = new ConditionalJump;
   cjmp->lhs = counter_().get();
@@ -223,6 +514,23 @@ Instruction* CompiledRegex::storeMatch() {
   inst->dest = longestMatch_().get();
   return inst;
 }
+size_t CompiledRegex::addPatternSet(const std::vector<uint32_t>& patterns) {
+  auto [it, inserted] =
+      patternSetIds_.emplace(patterns, patternSets_.size());
+  if(inserted) patternSets_.push_back(patterns);
+  return it->second;
+}
+Instruction* CompiledRegex::storePatternSet(size_t set) {
+  Copy* inst = new Copy;
+  inst->source = Variable::buildImmediate(Types::LONG, set);
+  inst->dest = matchedSet_().get();
+  return inst;
+}
+Instruction* CompiledRegex::jumpToDone() {
+  Jump* jmp = new Jump;
+  jmp->target = doneState;
+  return jmp;
+}
 Instruction* CompiledRegex::matchChar(char c, Instruction* jumpTo) {
   ConditionalJump* cjmp = new ConditionalJump;
   cjmp->lhs = next_().get();
@@ -3,11 +3,13 @@
 
 #include <array>
 #include <cassert>
+#include <cstdint>
+#include <map>
 #include <memory>
 #include <string>
 #include <vector>
 
-enum class Types { CHAR, CHAR_STAR, CONST_CHAR_STAR, LONG, INT };
+enum class Types { CHAR, CHAR_STAR, CONST_CHAR_STAR, LONG, LONG_STAR, INT };
 std::string toString(Types t);
 
 enum class X86Register { NONE, DI, SI, D, A, C, R8, R9, R10, R11 };
@@ -107,12 +109,19 @@ public:
 struct Instruction {
   Instruction* prev = nullptr;
   Instruction* next = nullptr;
+  // position in the function, set by CompiledRegex before emitting so labels
+  // are the same on every run
+  size_t id = 0;
   virtual ~Instruction() = default;
+  // x86-64 machine code. a jump ends in a rel32 displacement to `jumpTarget`
+  // that is left 0, it can only be filled in once every instruction has an
+  // address, see CompiledRegex::toBytes
   virtual std::vector<unsigned char> toBytes() { return {}; }
+  virtual Instruction* jumpTarget() { return nullptr; }
   virtual std::string toC() { return ""; }
   virtual std::string toNasm() { return ""; }
   virtual std::string getCLabel() {
-    return "state_" + std::to_string(intptr_t(this));
+    return "state_" + std::to_string(id);
   }
   virtual std::string getNasmLabel() { return "." + getCLabel(); }
 };
@@ -131,7 +140,7 @@ struct Load : public Instruction {
   Variable* dest = nullptr;
   Variable* base = nullptr;
   Variable* offset = nullptr;
-  std::vector<unsigned char> toBytes() override { return {}; }
+  std::vector<unsigned char> toBytes() override;
   std::string toC() override {
     std::string ret = dest->getLValue() + " = *(" + base->getRValue() + " + " +
                       offset->getRValue() + ");";
@@ -150,7 +159,7 @@ struct Load : public Instruction {
 struct Add : public Instruction {
   Variable* dest = nullptr;
   Variable* op1 = nullptr;
-  std::vector<unsigned char> toBytes() override { return {}; }
+  std::vector<unsigned char> toBytes() override;
   std::string toC() override {
     std::string ret = dest->getLValue() + " += " + op1->getRValue() + ";";
     return ret;
@@ -161,11 +170,26 @@ struct Add : public Instruction {
     return ret;
   }
 };
+struct Sub : public Instruction {
+  Variable* dest = nullptr;
+  Variable* op1 = nullptr;
+  std::vector<unsigned char> toBytes() override;
+  std::string toC() override {
+    std::string ret = dest->getLValue() + " -= " + op1->getRValue() + ";";
+    return ret;
+  }
+  std::string toNasm() override {
+    std::string ret =
+        "sub " + dest->getLValue(true) + ", " + op1->getRValue(true);
+    return ret;
+  }
+};
 enum class ConditionCode { EQ, NEQ, GT, GTEQ, LT, LTEQ };
 std::string toString(ConditionCode cc, bool isAsm = false);
 struct Jump : public Instruction {
   Instruction* target = nullptr;
-  std::vector<unsigned char> toBytes() override { return {}; }
+  std::vector<unsigned char> toBytes() override;
+  Instruction* jumpTarget() override { return target; }
   std::string toC() override {
     std::string ret = "goto " + target->getCLabel() + ";";
     return ret;
@@ -180,7 +204,8 @@ struct ConditionalJump : public Instruction {
   Variable* rhs = nullptr;
   ConditionCode cc;
   Instruction* target = nullptr;
-  std::vector<unsigned char> toBytes() override { return {}; }
+  std::vector<unsigned char> toBytes() override;
+  Instruction* jumpTarget() override { return target; }
   std::string toC() override {
     std::string ret = "if(" + lhs->getRValue() + " " + toString(cc) + " " +
                       rhs->getRValue() + ") goto " + target->getCLabel() + ";";
@@ -196,7 +221,7 @@ struct ConditionalJump : public Instruction {
 struct Copy : public Instruction {
   Variable* dest = nullptr;
   Variable* source = nullptr;
-  std::vector<unsigned char> toBytes() override { return {}; }
+  std::vector<unsigned char> toBytes() override;
   std::string toC() override {
     std::string ret = dest->getLValue() + " = " + source->getRValue() + ";";
     return ret;
@@ -207,11 +232,28 @@ struct Copy : public Instruction {
     return ret;
   }
 };
+// write through a pointer
+struct Store : public Instruction {
+  Variable* address = nullptr;
+  Variable* source = nullptr;
+  std::vector<unsigned char> toBytes() override;
+  std::string toC() override {
+    std::string ret =
+        "*" + address->getRValue() + " = " + source->getRValue() + ";";
+    return ret;
+  }
+  std::string toNasm() override {
+    std::string ret = "mov qword [" + address->getRValue(true) + "], " +
+                      source->getRValue(true);
+    return ret;
+  }
+};
 struct Return : public Instruction {
   Variable* value = nullptr;
-  std::vector<unsigned char> toBytes() override { return {}; }
+  std::vector<unsigned char> toBytes() override;
   std::string toC() override {
-    std::string ret = this->getCLabel() + ": return" + value->getRValue() + ";";
+    std::string ret =
+        this->getCLabel() + ": return " + value->getRValue() + ";";
     return ret;
   }
   std::string toNasm() override {
@@ -465,13 +507,34 @@ template <size_t Parameters, size_t Locals> struct Function {
 
 class State;
 
+// what a generated matcher looks for, all of them return -1 when there is no
+// match
+enum class MatchMode {
+  // the length of the longest match starting at input[0]
+  Longest,
+  // where the first match to end ends, returning at the first accept. for
+  // unanchored DFAs
+  Earliest,
+  // reads the input backwards from its end and returns the smallest position
+  // p where input[p, length) matches. for reversed DFAs
+  Reverse,
+};
+
+// a matcher that reports patterns takes a third parameter,
+// `long* matchedSet`, and stores the id of the pattern set of the longest
+// match through it before returning. sets are emitted by `toPatternSets`, set
+// 0 is empty and is what is reported when nothing matched
 class CompiledRegex {
 public:
-  CompiledRegex() {
+  explicit CompiledRegex(
+      bool reportPatterns = false,
+      MatchMode mode = MatchMode::Longest)
+      : mode_(mode) {
     // function signature
     func.retType = Types::LONG;
     func.argTypes[0] = Types::CONST_CHAR_STAR;
     func.argTypes[1] = Types::LONG;
+    func.argTypes[2] = Types::LONG_STAR;
 
     //  parameters
     input_() = Variable::buildParameter(
@@ -484,17 +547,50 @@ public:
         argumentRegisters[1]);
 
     // locals
-    counter_() =
-        Variable::buildLocal(Types::LONG, "counter", 0, argumentRegisters[2]);
+    // the third argument register is taken when reporting patterns, so the
+    // counter moves up to r8
+    auto counterReg = reportPatterns ? argumentRegisters[4]
+                                     : argumentRegisters[2];
+    counter_() = Variable::buildLocal(Types::LONG, "counter", 0, counterReg);
     longestMatch_() =
         Variable::buildLocal(Types::LONG, "longestMatch", -1, returnRegister);
     next_() = Variable::buildLocal(Types::CHAR, "next", argumentRegisters[3]);
 
-    doneState = new Return();
-    ((Return*)doneState)->value = longestMatch_().get();
-    func.instructions.addBack(doneState);
+    if(reportPatterns) {
+      matchedSetOut_() = Variable::buildParameter(
+          func.argTypes[2],
+          "matchedSet",
+          argumentRegisters[2]);
+      matchedSet_() =
+          Variable::buildLocal(Types::LONG, "set", 0, argumentRegisters[5]);
+      patternSets_.emplace_back();
+      patternSetIds_.emplace(std::vector<uint32_t>(), 0);
+
+      // every path out of the function stores the set first
+      doneState = new NOP();
+      func.instructions.addBack(doneState);
+      Store* store = new Store;
+      store->address = matchedSetOut_().get();
+      store->source = matchedSet_().get();
+      func.instructions.addBack(store);
+      Return* ret = new Return();
+      ret->value = longestMatch_().get();
+      func.instructions.addBack(ret);
+    } else {
+      doneState = new Return();
+      ((Return*)doneState)->value = longestMatch_().get();
+      func.instructions.addBack(doneState);
+    }
 
     insertPoint = nullptr;
+    if(mode_ == MatchMode::Reverse) {
+      // start from the end, the blocks go after this
+      Copy* start = new Copy;
+      start->dest = counter_().get();
+      start->source = length_().get();
+      func.instructions.addFront(start);
+      insertPoint = start;
+    }
   }
   ~CompiledRegex() = default;
   CompiledRegex(const CompiledRegex& other) = delete;
@@ -505,24 +601,50 @@ public:
 public:
   std::string toC(std::string name = "match");
   std::string toNasm(std::string name = "match");
+  // the machine code of the function, what assembling toNasm would give, with
+  // every jump resolved. see JITRegex
+  std::vector<unsigned char> toBytes();
   std::string toHeader(std::string name = "match");
+  // definitions of the pattern set table, `<name>_sets`
+  std::string toPatternSets(std::string name = "match");
 
 public:
-  InstructionList* getNewBlockForState(State*);
+  InstructionList* getNewBlockForState(size_t state);
   void finishBlock(InstructionList* il);
 
   Instruction* storeMatch();
   Instruction* matchChar(char c, Instruction* jumpTo);
+  Instruction* jumpToDone();
+  MatchMode mode() const { return mode_; }
+
+  bool reportsPatterns() const { return matchedSet_() != nullptr; }
+  const std::vector<std::vector<uint32_t>>& patternSets() const {
+    return patternSets_;
+  }
+  // returns the id of the set, adding it if it is new
+  size_t addPatternSet(const std::vector<uint32_t>& patterns);
+  Instruction* storePatternSet(size_t set);
 
 private:
-  Function<2, 3> func;
+  void numberInstructions();
+
+  // the pattern set slots are left empty when patterns aren't reported
+  Function<3, 4> func;
+  MatchMode mode_;
   Instruction* doneState;
   Instruction* insertPoint;
+  std::vector<std::vector<uint32_t>> patternSets_;
+  std::map<std::vector<uint32_t>, size_t> patternSetIds_;
   std::unique_ptr<Variable>& input_() { return func.variables[0]; }
   std::unique_ptr<Variable>& length_() { return func.variables[1]; }
   std::unique_ptr<Variable>& counter_() { return func.variables[2]; }
   std::unique_ptr<Variable>& longestMatch_() { return func.variables[3]; }
   std::unique_ptr<Variable>& next_() { return func.variables[4]; }
+  std::unique_ptr<Variable>& matchedSetOut_() { return func.variables[5]; }
+  std::unique_ptr<Variable>& matchedSet_() { return func.variables[6]; }
+  const std::unique_ptr<Variable>& matchedSet_() const {
+    return func.variables[6];
+  }
 };
 
 #endif
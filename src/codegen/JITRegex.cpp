@@ -0,0 +1,64 @@
+#include "JITRegex.h"
+
+#include <cstring>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <utility>
+
+std::optional<JITRegex> JITRegex::compile(CompiledRegex& compiled) {
+#if defined(__x86_64__)
+  auto code = compiled.toBytes();
+  static const size_t pageSize = size_t(sysconf(_SC_PAGESIZE));
+  size_t size = (code.size() + pageSize - 1) / pageSize * pageSize;
+
+  // written while only writable, then flipped to only executable
+  void* memory = mmap(
+      nullptr,
+      size,
+      PROT_READ | PROT_WRITE,
+      MAP_PRIVATE | MAP_ANONYMOUS,
+      -1,
+      0);
+  if(memory == MAP_FAILED) return {};
+  std::memcpy(memory, code.data(), code.size());
+  if(mprotect(memory, size, PROT_READ | PROT_EXEC) != 0) {
+    munmap(memory, size);
+    return {};
+  }
+
+  JITRegex jit;
+  jit.memory_ = memory;
+  jit.size_ = size;
+  jit.reportsPatterns_ = compiled.reportsPatterns();
+  jit.patternSets_ = compiled.patternSets();
+  return jit;
+#else
+  (void)compiled;
+  return {};
+#endif
+}
+
+JITRegex::~JITRegex() { release(); }
+
+JITRegex::JITRegex(JITRegex&& other) noexcept
+    : memory_(std::exchange(other.memory_, nullptr)),
+      size_(std::exchange(other.size_, 0)),
+      reportsPatterns_(other.reportsPatterns_),
+      patternSets_(std::move(other.patternSets_)) {}
+
+JITRegex& JITRegex::operator=(JITRegex&& other) noexcept {
+  if(this != &other) {
+    release();
+    memory_ = std::exchange(other.memory_, nullptr);
+    size_ = std::exchange(other.size_, 0);
+    reportsPatterns_ = other.reportsPatterns_;
+    patternSets_ = std::move(other.patternSets_);
+  }
+  return *this;
+}
+
+void JITRegex::release() {
+  if(memory_) munmap(memory_, size_);
+  memory_ = nullptr;
+  size_ = 0;
+}
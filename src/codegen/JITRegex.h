@@ -0,0 +1,72 @@
+#ifndef OPAL_CODEGEN_JITREGEX_H_
+#define OPAL_CODEGEN_JITREGEX_H_
+
+#include "Instruction.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <vector>
+
+// runs a CompiledRegex as native code in this process, from
+// CompiledRegex::toBytes, so no assembler, compiler or linker is needed
+// the code is copied into fresh pages that are then made read only and
+// executable, so they are never writable and executable at once. x86-64 only
+class JITRegex {
+public:
+  using MatchFunction = long (*)(const char* input, long length);
+  using ReportingMatchFunction =
+      long (*)(const char* input, long length, long* matchedSet);
+
+private:
+  void* memory_ = nullptr;
+  size_t size_ = 0;
+  bool reportsPatterns_ = false;
+  std::vector<std::vector<uint32_t>> patternSets_;
+
+public:
+  // empty when mapping the code fails or this isn't x86-64
+  static std::optional<JITRegex> compile(CompiledRegex& compiled);
+
+  JITRegex() = default;
+  ~JITRegex();
+  JITRegex(const JITRegex& other) = delete;
+  JITRegex(JITRegex&& other) noexcept;
+  JITRegex& operator=(const JITRegex& other) = delete;
+  JITRegex& operator=(JITRegex&& other) noexcept;
+
+  // the code itself, only for matchers that don't report patterns
+  MatchFunction function() const {
+    if(reportsPatterns_) return nullptr;
+    return reinterpret_cast<MatchFunction>(memory_);
+  }
+  ReportingMatchFunction reportingFunction() const {
+    if(!reportsPatterns_) return nullptr;
+    return reinterpret_cast<ReportingMatchFunction>(memory_);
+  }
+
+  // same contract as the generated matchers, `matchedSet` gets the pattern
+  // set of the match when patterns are reported
+  long match(const char* input, long length, long* matchedSet = nullptr)
+      const {
+    if(!reportsPatterns_) return function()(input, length);
+    long set = 0;
+    long result = reportingFunction()(input, length, &set);
+    if(matchedSet) *matchedSet = set;
+    return result;
+  }
+  long operator()(const char* input, long length) const {
+    return match(input, length);
+  }
+
+  bool reportsPatterns() const { return reportsPatterns_; }
+  const std::vector<uint32_t>& patterns(size_t set) const {
+    return patternSets_[set];
+  }
+  size_t codeBytes() const { return size_; }
+
+private:
+  void release();
+};
+
+#endif
@@ -0,0 +1,71 @@
+#include "MappedFile.h"
+
+#include <cstdint>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <utility>
+
+namespace common {
+
+MappedFile::~MappedFile() { close(); }
+
+MappedFile::MappedFile(MappedFile&& other) noexcept
+    : data_(std::exchange(other.data_, nullptr)),
+      size_(std::exchange(other.size_, 0)) {}
+
+MappedFile& MappedFile::operator=(MappedFile&& other) noexcept {
+  if(this != &other) {
+    close();
+    data_ = std::exchange(other.data_, nullptr);
+    size_ = std::exchange(other.size_, 0);
+  }
+  return *this;
+}
+
+bool MappedFile::open(const std::string& path, Access access) {
+  close();
+  int fd = ::open(path.c_str(), O_RDONLY);
+  if(fd < 0) return false;
+  struct stat st;
+  if(fstat(fd, &st) != 0) {
+    ::close(fd);
+    return false;
+  }
+  // mmap can't map nothing, an empty file is just an empty range
+  if(st.st_size == 0) {
+    ::close(fd);
+    return true;
+  }
+  void* p = mmap(nullptr, size_t(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+  // the mapping keeps the file open
+  ::close(fd);
+  if(p == MAP_FAILED) return false;
+  data_ = static_cast<const char*>(p);
+  size_ = size_t(st.st_size);
+  madvise(
+      p,
+      size_,
+      access == Access::Sequential ? MADV_SEQUENTIAL : MADV_RANDOM);
+  return true;
+}
+
+void MappedFile::willNeed(const char* begin, const char* end) const {
+  if(begin == end) return;
+  // madvise wants a page aligned start
+  static const uintptr_t pageSize = uintptr_t(sysconf(_SC_PAGESIZE));
+  auto start = reinterpret_cast<uintptr_t>(begin) & ~(pageSize - 1);
+  madvise(
+      reinterpret_cast<void*>(start),
+      reinterpret_cast<uintptr_t>(end) - start,
+      MADV_WILLNEED);
+}
+
+void MappedFile::close() {
+  if(data_) munmap(const_cast<char*>(data_), size_);
+  data_ = nullptr;
+  size_ = 0;
+}
+
+} // namespace common
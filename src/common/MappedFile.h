@@ -0,0 +1,48 @@
+#ifndef OPAL_COMMON_MAPPEDFILE_H_
+#define OPAL_COMMON_MAPPEDFILE_H_
+
+#include <cstddef>
+#include <string>
+
+namespace common {
+// a whole file mapped read only, unmapped when destroyed
+// processes mapping the same file share its pages in the page cache
+class MappedFile {
+public:
+  // how the mapping will be read, passed on to the kernel
+  enum class Access {
+    // read ahead aggressively and drop pages behind the reader
+    Sequential,
+    // no read ahead
+    Random,
+  };
+
+private:
+  const char* data_ = nullptr;
+  size_t size_ = 0;
+
+public:
+  MappedFile() = default;
+  ~MappedFile();
+  MappedFile(const MappedFile& other) = delete;
+  MappedFile(MappedFile&& other) noexcept;
+  MappedFile& operator=(const MappedFile& other) = delete;
+  MappedFile& operator=(MappedFile&& other) noexcept;
+
+  // returns false with errno set if the file can't be mapped
+  bool open(const std::string& path, Access access = Access::Sequential);
+
+  const char* data() const { return data_; }
+  size_t size() const { return size_; }
+  const char* begin() const { return data_; }
+  const char* end() const { return data_ + size_; }
+
+  // starts reading [begin, end) in before it is touched
+  void willNeed(const char* begin, const char* end) const;
+
+private:
+  void close();
+};
+} // namespace common
+
+#endif
@@ -0,0 +1,37 @@
+#include "ThreadPool.h"
+
+#include <algorithm>
+
+namespace common {
+ThreadPool::ThreadPool(size_t nThreads) {
+  if(nThreads == 0)
+    nThreads = std::max(1u, std::thread::hardware_concurrency());
+  threads_.reserve(nThreads);
+  for(size_t i = 0; i < nThreads; i++)
+    threads_.emplace_back([this]() { work(); });
+}
+
+ThreadPool::~ThreadPool() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stopping_ = true;
+  }
+  ready_.notify_all();
+  for(auto& t : threads_)
+    t.join();
+}
+
+void ThreadPool::work() {
+  while(true) {
+    std::function<void()> task;
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      ready_.wait(lock, [this]() { return stopping_ || !tasks_.empty(); });
+      if(tasks_.empty()) return;
+      task = std::move(tasks_.front());
+      tasks_.pop();
+    }
+    task();
+  }
+}
+} // namespace common
@@ -0,0 +1,52 @@
+#ifndef OPAL_COMMON_THREADPOOL_H_
+#define OPAL_COMMON_THREADPOOL_H_
+
+#include <condition_variable>
+#include <cstddef>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+namespace common {
+// a fixed set of threads taking tasks off one queue, in the order they were
+// submitted. executables using it need to link pthread
+class ThreadPool {
+private:
+  std::vector<std::thread> threads_;
+  std::queue<std::function<void()>> tasks_;
+  std::mutex mutex_;
+  std::condition_variable ready_;
+  bool stopping_ = false;
+
+public:
+  // 0 is one thread per hardware thread
+  explicit ThreadPool(size_t nThreads = 0);
+  // runs everything already submitted, then joins
+  ~ThreadPool();
+  ThreadPool(const ThreadPool& other) = delete;
+  ThreadPool& operator=(const ThreadPool& other) = delete;
+
+  size_t size() const { return threads_.size(); }
+
+  // queues `f`, the future holds its result or what it threw
+  template <class F> auto submit(F f) -> std::future<decltype(f())> {
+    using Result = decltype(f());
+    auto task = std::make_shared<std::packaged_task<Result()>>(std::move(f));
+    auto future = task->get_future();
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      tasks_.emplace([task]() { (*task)(); });
+    }
+    ready_.notify_one();
+    return future;
+  }
+
+private:
+  void work();
+};
+} // namespace common
+#endif
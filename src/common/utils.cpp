@@ -40,6 +40,14 @@ std::vector<std::string> split(const std::string& str, const std::string& sep) {
 bool startsWith(const std::string& str, const std::string& prefix) {
   return str.find(prefix, 0) == 0;
 }
+uint64_t fnv1a(const void* data, size_t size, uint64_t hash) {
+  auto bytes = static_cast<const unsigned char*>(data);
+  for(size_t i = 0; i < size; i++) {
+    hash ^= bytes[i];
+    hash *= 1099511628211ull;
+  }
+  return hash;
+}
 
 } // namespace utils
 } // namespace common
@@ -1,5 +1,7 @@
 #ifndef OPAL_COMMON_UTILS_H_
 #define OPAL_COMMON_UTILS_H_
+#include <cstddef>
+#include <cstdint>
 #include <functional>
 #include <initializer_list>
 #include <string>
@@ -39,6 +41,10 @@ std::string join(
   return res;
 }
 extern bool startsWith(const std::string& str, const std::string& starts);
+// 64 bit FNV-1a, pass the previous hash back in to hash several pieces as one
+constexpr uint64_t fnvOffsetBasis = 14695981039346656037ull;
+extern uint64_t
+fnv1a(const void* data, size_t size, uint64_t hash = fnvOffsetBasis);
 
 } // namespace utils
 } // namespace common
@@ -0,0 +1,12 @@
+#ifndef OPAL_COMMON_VERSION_H_
+#define OPAL_COMMON_VERSION_H_
+
+// bumped whenever the same input can compile to different output, anything
+// cached under an older version is ignored
+#define OPAL_VERSION "0.2.0"
+
+namespace common {
+constexpr const char* version = OPAL_VERSION;
+} // namespace common
+
+#endif
@@ -4,9 +4,11 @@ codegen=
 dot=
 parser=
 state=
-test=codegen state parser dot common
-viewer=codegen state parser dot common
-matcher_builder=codegen state parser dot common
+pipeline=parser state codegen dot common
+test=pipeline parser state codegen dot common
+viewer=pipeline parser state codegen dot common
+matcher_builder=pipeline parser state codegen dot common
+scanner=pipeline parser state codegen dot common
 
 
 define make_depen
@@ -14,5 +16,5 @@ $(eval $1: $($1))
 endef
 map = $(foreach a,$(2),$(call $(1),$(a)))
 define make_prereqs
-$(call map,make_depen,test viewer matcher_builder codegen state parser dot common)
+$(call map,make_depen,test viewer matcher_builder scanner pipeline codegen state parser dot common)
 endef
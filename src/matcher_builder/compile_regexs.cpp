@@ -1,60 +1,166 @@
 
-#include "parser/parse_regex.h"
-#include "state/DFA.h"
+#include "pipeline/CompileCache.h"
+#include "pipeline/PassManager.h"
+#include "state/DFAImage.h"
+#include "state/DenseDFA.h"
+#include "state/Prefilter.h"
+#include "state/ShuffleDFA.h"
 
 #include <fstream>
 #include <iostream>
+#include <optional>
+#include <utility>
 #include <vector>
 
 int main(int argc, char** argv) {
 
-  Parser p;
-  std::vector<std::pair<std::string, CompiledRegex>> patterns;
-
+  PassManager::Options options;
+  bool printStats = false;
+  bool stream = false;
+  bool batch = false;
+  bool shuffle = true;
+  bool image = false;
+  std::vector<std::string> regexs;
   for(int i = 1; i < argc; i++) {
+    std::string arg(argv[i]);
+    if(arg == "--stats") printStats = true;
+    else if(arg == "--dump-dot") options.dumpDot = true;
+    else if(arg == "--glushkov")
+      options.construction = Parser::Construction::Glushkov;
+    else if(arg == "--search") options.search = true;
+    else if(arg == "--stream") stream = true;
+    else if(arg == "--batch") batch = true;
+    else if(arg == "--no-shuffle") shuffle = false;
+    else if(arg == "--image") image = true;
+    else if(arg == "--cache" && i + 1 < argc) options.cacheDir = argv[++i];
+    else regexs.push_back(arg);
+  }
 
-    std::string str(argv[i]);
-    auto sl = p.parse(str, [](auto msg) { std::cerr << msg << "\n"; });
-    if(!sl) {
-      std::cerr << "error parsing regex: '" << str << "'\n";
-      continue;
-    }
-    sl->prune();
-    auto dfa = sl->buildDFA();
-    dfa.prune();
+  system("mkdir -p bin");
 
-    if(!dfa.isDFA()) {
-      std::cerr << "error converting regex: '" << str << "'\n";
-      continue;
+  // the outputs for the whole set are cached under everything that goes into
+  // them. on a miss the passes still reuse the cached dfa of every pattern
+  // that didn't change
+  std::optional<CompileCache> cache;
+  std::string setKey;
+  std::vector<std::pair<std::string, std::string>> outputs = {
+      {"asm", "bin/matchers.asm"},
+      {"c", "bin/defs.c"},
+      {"o", "bin/matchers.o"}};
+  if(image) outputs.push_back({"dfa", "bin/match.dfa"});
+  if(!options.cacheDir.empty()) {
+    cache.emplace(options.cacheDir);
+    bool glushkov = options.construction == Parser::Construction::Glushkov;
+    std::vector<std::string> parts = {
+        "matcher",
+        glushkov ? "glushkov" : "thompson",
+        options.search ? "search" : "",
+        stream ? "stream" : "",
+        batch ? "batch" : "",
+        shuffle ? "shuffle" : ""};
+    parts.insert(parts.end(), regexs.begin(), regexs.end());
+    setKey = CompileCache::key(parts);
+    bool hit = true;
+    for(const auto& [name, path] : outputs)
+      hit = hit && cache->getFile(setKey, name, path);
+    if(hit) {
+      if(printStats) std::cout << "cached as " << setKey << "\n";
+      system("clang template/main.c bin/defs.c bin/matchers.o -o a.out");
+      return 0;
     }
+  }
 
-    auto cr = dfa.compile();
-    patterns.push_back({str, std::move(cr)});
+  // patterns without a literal can't be prefiltered, and neither can any set
+  // holding one of them. each pattern is determinized on its own for this, so
+  // it is only done for --stats
+  // with a cache the minimal DFA of each pattern comes from it, so only new or
+  // changed patterns are determinized, and the parse pass finds them there too
+  // patterns that don't parse are left to the parse pass to report
+  if(printStats) {
+    Parser parser(options.construction);
+    for(const auto& r : regexs) {
+      std::optional<Automaton> dfa;
+      if(cache) dfa = cache->patternDFA(r, options.construction);
+      else if(auto nfa = parser.parseAutomaton(r))
+        dfa = nfa->buildDFA().prune().minimize();
+      if(!dfa || !dfa->isDFA()) continue;
+      std::cout << "pattern '" << r << "': "
+                << dfa->requiredLiterals().toString() << "\n";
+    }
   }
 
-  system("mkdir -p bin");
+  auto pm = PassManager::standard(options);
+
+  // every pattern goes into one automaton, so a lookup is one pass over the
+  // input no matter how many patterns there are
+  PipelineState state;
+  state.patterns = regexs;
+  bool ok = pm.run(state, [](auto msg) { std::cerr << msg << "\n"; });
+  if(printStats) std::cout << pm.statsToString();
+  if(!ok) return 1;
+  auto& compiled = *state.compiled;
+  Prefilter prefilter(*state.literals);
+  if(printStats)
+    std::cout << "pattern set: " << prefilter.literals().toString() << "\n";
+
   std::ofstream outAsm("bin/matchers.asm");
   std::ofstream outDefs("bin/defs.c");
 
-  for(auto it = patterns.begin(); it != patterns.end(); it++) {
-    auto idx = std::distance(patterns.begin(), it);
-    std::string name = "match" + std::to_string(idx);
-    outAsm << it->second.toNasm(name) << "\n";
-    outDefs << it->second.toHeader(name) << "\n";
+  // small DFAs move through every state with one shuffle per byte instead of
+  // branching on each edge, see ShuffleDFA. the matchers are built to run
+  // here, so only when this machine has the instructions for it
+  outDefs << "#define _GNU_SOURCE\n#include <string.h>\n#include <sys/uio.h>\n";
+  const auto& dfa = *state.states;
+  if(shuffle && ShuffleDFA::fits(dfa) && ShuffleDFA::canRunNasm()) {
+    ShuffleDFA shuffleDFA(dfa);
+    if(printStats)
+      std::cout << "shuffle matcher with " << shuffleDFA.size() << " states\n";
+    outAsm << shuffleDFA.toNasm("match") << "\n";
+    outDefs << shuffleDFA.toHeader("match") << "\n";
+    outDefs << shuffleDFA.toPatternSets("match") << "\n";
+  } else {
+    outAsm << compiled.toNasm("match") << "\n";
+    outDefs << compiled.toHeader("match") << "\n";
+    outDefs << compiled.toPatternSets("match") << "\n";
   }
+  outDefs << prefilter.toC("match_mayMatch") << "\n";
 
-  outDefs << "typedef long (*matchFunc)(const char*, long);\n";
+  // match_search finds a match anywhere in the input, see Searcher
+  if(options.search) {
+    outAsm << state.compiledForward->toNasm("match_forward") << "\n";
+    outAsm << state.compiledReverse->toNasm("match_reverse") << "\n";
+    outDefs << state.compiledForward->toHeader("match_forward") << "\n";
+    outDefs << state.compiledReverse->toHeader("match_reverse") << "\n";
+    outDefs << "long match_search(const char* input, long length, "
+               "long* start, long* matchedSet) {\n"
+               "  if(match_forward(input, length) < 0) return -1;\n"
+               "  *start = match_reverse(input, length);\n"
+               "  return *start + match(input + *start, length - *start, "
+               "matchedSet);\n"
+               "}\n";
+  }
 
-  outDefs << "long nPatterns = " << std::to_string(patterns.size()) << ";\n";
-  outDefs << "matchFunc funcs[] = {\n";
-  for(auto it = patterns.begin(); it != patterns.end(); it++) {
-    auto idx = std::distance(patterns.begin(), it);
-    outDefs << "match" << std::to_string(idx) << ",\n";
+  // match_stream takes input in pieces and match_matchBatch takes many inputs
+  // at once, both run a table instead of asm since they stop and resume in
+  // any state
+  if(stream || batch) {
+    DenseDFA dense(dfa);
+    outDefs << dense.toTablesC("match") << "\n";
+    if(stream) outDefs << dense.toStreamC("match") << "\n";
+    if(batch) outDefs << dense.toBatchC("match") << "\n";
   }
-  outDefs << "};\n";
+
+  // the dfa and its pattern sets for DFAImage::open, so processes can match
+  // without rebuilding or linking anything
+  if(image) {
+    std::ofstream outImage("bin/match.dfa", std::ios::binary);
+    outImage << DFAImage::build(dfa);
+  }
+
+  outDefs << "long nPatterns = " << std::to_string(regexs.size()) << ";\n";
   outDefs << "const char* patterns[] = {\n";
-  for(auto it = patterns.begin(); it != patterns.end(); it++) {
-    outDefs << "\"" << it->first << "\",\n";
+  for(const auto& r : regexs) {
+    outDefs << "\"" << r << "\",\n";
   }
   outDefs << "};\n";
 
@@ -62,6 +168,10 @@ int main(int argc, char** argv) {
   outDefs.close();
 
   system("nasm -felf64 bin/matchers.asm -o bin/matchers.o");
+  if(cache) {
+    for(const auto& [name, path] : outputs)
+      cache->putFile(setKey, name, path);
+  }
   system("clang template/main.c bin/defs.c bin/matchers.o -o a.out");
 
   return 0;
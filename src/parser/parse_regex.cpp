@@ -2,17 +2,18 @@
 
 #include "parse_regex.h"
 
-// using OwningStateList = std::vector<std::unique_ptr<State>>;
-// using StatesStartAccept = std::tuple<OwningStateList, State*, State*>;
-// returns start and accept
-std::optional<StateList> Parser::parse_expr(
-    std::string input,
+#include <unordered_set>
+
+// returns start and accepts
+std::optional<Parser::Fragment> Parser::parse_expr(
+    const std::string& input,
     size_t& offset,
+    Automaton::Builder& builder,
     std::function<void(std::string_view msg)> errFunc) {
   char next = input[offset++];
 
   if(next == '(') {
-    auto lhs = parse_expr(input, offset, errFunc);
+    auto lhs = parse_expr(input, offset, builder, errFunc);
     if(!lhs) return {};
 
     decltype(lhs) rhs;
@@ -28,7 +29,7 @@ std::optional<StateList> Parser::parse_expr(
         if(errFunc) errFunc("expected paren");
         return {};
       }
-      rhs = parse_expr(input, offset, errFunc);
+      rhs = parse_expr(input, offset, builder, errFunc);
       if(!rhs) return {};
       if(input[offset++] != ')') {
         if(errFunc) errFunc("unmatched paren");
@@ -39,21 +40,11 @@ std::optional<StateList> Parser::parse_expr(
       // lhs.accept -> rhs.start
       // unmark lhs.accept as an accept
       // return {lhs.start, rhs.accept}
-
-      // OwningStateList& lhs_states = std::get<0>(*lhs);
-      // OwningStateList& rhs_states = std::get<0>(*rhs);
-
-      // State* lhs_start = std::get<1>(*lhs);
-      // State* lhs_accept = std::get<2>(*lhs);
-      // State* rhs_start = std::get<1>(*rhs);
-      // State* rhs_accept = std::get<2>(*rhs);
-      // lhs_accept->setAccept(false);
-      // lhs_accept->addTransition(rhs_start);
-
-      // OwningStateList states;
-      // states.insert()
-
-      lhs->concatWith(*rhs);
+      for(auto accept : lhs->accepts) {
+        builder.addEdge(accept, rhs->entry);
+        builder.setAccept(accept, false);
+      }
+      lhs->accepts = std::move(rhs->accepts);
       return lhs;
 
     } else if(op == '|') {
@@ -61,18 +52,35 @@ std::optional<StateList> Parser::parse_expr(
         if(errFunc) errFunc("expected paren");
         return {};
       }
-      rhs = parse_expr(input, offset, errFunc);
+      rhs = parse_expr(input, offset, builder, errFunc);
       if(!rhs) return {};
       if(input[offset++] != ')') {
         if(errFunc) errFunc("unmatched paren");
         return {};
       }
 
-      lhs->unionWith(*rhs);
+      // add a new entry which has epsilon transitions to both of the old
+      // entrys
+      auto newEntry = builder.addState();
+      builder.addEdge(newEntry, lhs->entry);
+      builder.addEdge(newEntry, rhs->entry);
+      lhs->entry = newEntry;
+      lhs->accepts.insert(
+          lhs->accepts.end(),
+          rhs->accepts.begin(),
+          rhs->accepts.end());
       return lhs;
 
     } else if(op == '*') {
-      lhs->kleene();
+      // add a new entry which is also an accept with epsilon to old entry
+      // add epsilon from all old accepts to old entry
+      for(auto accept : lhs->accepts) {
+        builder.addEdge(accept, lhs->entry);
+      }
+      auto newEntry = builder.addState(true);
+      builder.addEdge(newEntry, lhs->entry);
+      lhs->entry = newEntry;
+      lhs->accepts.push_back(newEntry);
       return lhs;
     } else {
       if(errFunc) errFunc("unknown op");
@@ -81,26 +89,155 @@ std::optional<StateList> Parser::parse_expr(
 
   } else {
     // consume the char
-    auto start = std::make_unique<State>();
-    auto accept = std::make_unique<State>(true);
+    auto start = builder.addState();
+    auto accept = builder.addState(true);
 
     if(next == '_') {
       // epsilon trans
-      start->addTransition(accept.get());
+      builder.addEdge(start, accept);
     } else {
-      start->addTransition(accept.get(), next);
+      builder.addEdge(start, accept, (unsigned char)next);
     }
 
-    auto start_ptr = start.get();
-    auto accept_ptr = accept.get();
+    return Fragment{start, {accept}};
+  }
+}
 
-    StateList sl;
-    sl.addEntry(std::move(start));
-    sl.add(std::move(accept));
+/*
+glushkov construction
+
+every char in the regex is a position and gets its own state, an edge from
+position p to position q is labeled with q's char, so every edge entering a
+state has the same label
+
+first(e)    positions that can match the first char of e
+last(e)     positions that can match the last char of e
+nullable(e) e matches the empty string
+follow      for concat every last of lhs is followed by every first of rhs,
+            for star every last is followed by every first
+
+the entry has an edge to every first of the whole regex, accepts are the last
+positions plus the entry if the regex is nullable
+*/
+
+struct Parser::GlushkovBuilder {
+  Automaton::Builder builder;
+  // the char each position matches, indexed by state id
+  std::vector<Automaton::Label> labelOf;
+  // nested stars can add the same follow edge more than once
+  std::unordered_set<uint64_t> edges;
+
+  Automaton::StateId addPosition(unsigned char c) {
+    auto s = builder.addState();
+    labelOf.resize(s + 1);
+    labelOf[s] = c;
+    return s;
+  }
+  void follow(
+      const std::vector<Automaton::StateId>& from,
+      const std::vector<Automaton::StateId>& to) {
+    for(auto f : from) {
+      for(auto t : to) {
+        if(edges.insert(uint64_t(f) << 32 | t).second)
+          builder.addEdge(f, t, labelOf[t]);
+      }
+    }
+  }
+};
 
-    // OwningStateList states;
-    // states.push_back(std::move(start));
-    // states.push_back(std::move(accept));
-    return sl;
+std::optional<Automaton> Parser::parseGlushkov(
+    std::string input,
+    std::function<void(std::string_view msg)> errFunc) {
+  GlushkovBuilder gb;
+  auto entry = gb.builder.addState();
+  gb.labelOf.push_back(Automaton::Epsilon);
+
+  size_t offset = 0;
+  auto res = parse_positions(input, offset, gb, errFunc);
+  if(offset != input.size() || !res) {
+    if(errFunc && offset != input.size()) {
+      errFunc(
+          "did not match full input " + std::to_string(offset) +
+          "!=" + std::to_string(input.size()));
+    }
+    return {};
+  }
+
+  gb.follow({entry}, res->first);
+  for(auto s : res->last)
+    gb.builder.setAccept(s);
+  gb.builder.setAccept(entry, res->nullable);
+  gb.builder.setEntry(entry);
+  return gb.builder.build();
+}
+
+std::optional<Parser::Positions> Parser::parse_positions(
+    const std::string& input,
+    size_t& offset,
+    GlushkovBuilder& builder,
+    std::function<void(std::string_view msg)> errFunc) {
+  char next = input[offset++];
+
+  if(next == '(') {
+    auto lhs = parse_positions(input, offset, builder, errFunc);
+    if(!lhs) return {};
+
+    if(input[offset++] != ')') {
+      if(errFunc) errFunc("unmatched paren");
+      return {};
+    }
+    char op = input[offset++];
+
+    if(op == '*') {
+      builder.follow(lhs->last, lhs->first);
+      lhs->nullable = true;
+      return lhs;
+    } else if(op != '.' && op != '|') {
+      if(errFunc) errFunc("unknown op");
+      return {};
+    }
+
+    if(input[offset++] != '(') {
+      if(errFunc) errFunc("expected paren");
+      return {};
+    }
+    auto rhs = parse_positions(input, offset, builder, errFunc);
+    if(!rhs) return {};
+    if(input[offset++] != ')') {
+      if(errFunc) errFunc("unmatched paren");
+      return {};
+    }
+
+    if(op == '.') {
+      builder.follow(lhs->last, rhs->first);
+      if(lhs->nullable) {
+        lhs->first.insert(
+            lhs->first.end(),
+            rhs->first.begin(),
+            rhs->first.end());
+      }
+      if(rhs->nullable) {
+        rhs->last.insert(
+            rhs->last.end(),
+            lhs->last.begin(),
+            lhs->last.end());
+      }
+      lhs->last = std::move(rhs->last);
+      lhs->nullable = lhs->nullable && rhs->nullable;
+    } else {
+      lhs->first.insert(
+          lhs->first.end(),
+          rhs->first.begin(),
+          rhs->first.end());
+      lhs->last.insert(lhs->last.end(), rhs->last.begin(), rhs->last.end());
+      lhs->nullable = lhs->nullable || rhs->nullable;
+    }
+    return lhs;
+
+  } else if(next == '_') {
+    return Positions{{}, {}, true};
+  } else {
+    auto s = builder.addPosition((unsigned char)next);
+    return Positions{{s}, {s}, false};
   }
 }
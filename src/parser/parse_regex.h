@@ -2,12 +2,14 @@
 #define OPAL_PARSER_PARSE_REGEX_H_
 
 
+#include "state/Automaton.h"
 #include "state/DFA.h"
 
 #include <optional>
 // #include <tuple>
 #include <functional>
 #include <string>
+#include <vector>
 /*simple, easy to parse grammar
 later we can build a simple push down stack parser without . using precedence
 _ is epsilon
@@ -22,12 +24,41 @@ expr -> (expr)*
 
 class Parser {
 public:
+  enum class Construction {
+    // one fragment per operator glued together with epsilon edges
+    Thompson,
+    // position automaton, one state per char in the regex plus the entry and
+    // no epsilon edges
+    Glushkov,
+  };
+
+private:
+  Construction construction_;
+
+public:
+  explicit Parser(Construction construction = Construction::Thompson)
+      : construction_(construction) {}
+
   std::optional<StateList> parse(
       std::string input,
       std::function<void(std::string_view msg)> errFunc = {}) {
+    auto res = parseAutomaton(input, errFunc);
+    if(!res) return {};
+    return res->toStateList();
+  }
+
+  std::optional<Automaton> parseAutomaton(
+      std::string input,
+      std::function<void(std::string_view msg)> errFunc = {}) {
+    if(construction_ == Construction::Glushkov)
+      return parseGlushkov(input, errFunc);
     size_t offset = 0;
-    auto res = parse_expr(input, offset, errFunc);
-    if(offset == input.size() && res) return res;
+    Automaton::Builder builder;
+    auto res = parse_expr(input, offset, builder, errFunc);
+    if(offset == input.size() && res) {
+      builder.setEntry(res->entry);
+      return builder.build();
+    }
     if(errFunc && offset != input.size()) {
       errFunc(
           "did not match full input " + std::to_string(offset) +
@@ -36,13 +67,36 @@ public:
     return {};
   }
 
-private:
-  // using OwningStateList = std::vector<std::unique_ptr<State>>;
-  // using StatesStartAccept = std::tuple<OwningStateList, State*, State*>;
-  // returns start and accept
-  std::optional<StateList> parse_expr(
+  std::optional<Automaton> parseGlushkov(
       std::string input,
+      std::function<void(std::string_view msg)> errFunc = {});
+
+private:
+  // a piece of the automaton being built, all of its states live in the
+  // builder
+  struct Fragment {
+    Automaton::StateId entry;
+    std::vector<Automaton::StateId> accepts;
+  };
+  // returns start and accepts
+  std::optional<Fragment> parse_expr(
+      const std::string& input,
+      size_t& offset,
+      Automaton::Builder& builder,
+      std::function<void(std::string_view msg)> errFunc);
+
+  // the sets of positions a subexpression can start and end with, follow
+  // sets go straight into the builder as edges
+  struct Positions {
+    std::vector<Automaton::StateId> first;
+    std::vector<Automaton::StateId> last;
+    bool nullable;
+  };
+  struct GlushkovBuilder;
+  std::optional<Positions> parse_positions(
+      const std::string& input,
       size_t& offset,
+      GlushkovBuilder& builder,
       std::function<void(std::string_view msg)> errFunc);
 };
 #endif
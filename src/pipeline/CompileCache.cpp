@@ -0,0 +1,111 @@
+#include "CompileCache.h"
+
+#include "common/utils.h"
+#include "common/version.h"
+#include "state/DFAImage.h"
+
+#include <cinttypes>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <utility>
+
+CompileCache::CompileCache(std::string dir) : dir_(std::move(dir)) {
+  // mkdir -p, one component at a time
+  for(size_t slash = dir_.find('/', 1); slash != std::string::npos;
+      slash = dir_.find('/', slash + 1))
+    ::mkdir(dir_.substr(0, slash).c_str(), 0755);
+  ::mkdir(dir_.c_str(), 0755);
+}
+
+std::string CompileCache::key(const std::vector<std::string>& parts) {
+  // each part is prefixed with its length so ("ab", "c") and ("a", "bc")
+  // differ
+  std::string version(common::version);
+  uint64_t size = version.size();
+  uint64_t hash = common::utils::fnv1a(&size, sizeof(size));
+  hash = common::utils::fnv1a(version.data(), version.size(), hash);
+  for(const auto& part : parts) {
+    size = part.size();
+    hash = common::utils::fnv1a(&size, sizeof(size), hash);
+    hash = common::utils::fnv1a(part.data(), part.size(), hash);
+  }
+  char hex[17];
+  std::snprintf(hex, sizeof(hex), "%016" PRIx64, hash);
+  return hex;
+}
+
+std::optional<std::string> CompileCache::get(
+    const std::string& key,
+    const std::string& name) const {
+  std::ifstream in(path(key, name), std::ios::binary);
+  if(!in) return {};
+  std::stringstream ss;
+  ss << in.rdbuf();
+  return ss.str();
+}
+
+bool CompileCache::put(
+    const std::string& key,
+    const std::string& name,
+    std::string_view contents) const {
+  auto target = path(key, name);
+  auto tmp = target + ".tmp" + std::to_string(getpid());
+  {
+    std::ofstream out(tmp, std::ios::binary);
+    out.write(contents.data(), std::streamsize(contents.size()));
+    if(!out) {
+      std::remove(tmp.c_str());
+      return false;
+    }
+  }
+  return std::rename(tmp.c_str(), target.c_str()) == 0;
+}
+
+bool CompileCache::getFile(
+    const std::string& key,
+    const std::string& name,
+    const std::string& path) const {
+  auto contents = get(key, name);
+  if(!contents) return false;
+  std::ofstream out(path, std::ios::binary);
+  out << *contents;
+  return bool(out);
+}
+
+bool CompileCache::putFile(
+    const std::string& key,
+    const std::string& name,
+    const std::string& path) const {
+  std::ifstream in(path, std::ios::binary);
+  if(!in) return false;
+  std::stringstream ss;
+  ss << in.rdbuf();
+  return put(key, name, ss.str());
+}
+
+std::optional<Automaton> CompileCache::patternDFA(
+    const std::string& pattern,
+    Parser::Construction construction,
+    ErrorFunc errFunc) {
+  bool glushkov = construction == Parser::Construction::Glushkov;
+  auto k = key({"dfa", glushkov ? "glushkov" : "thompson", pattern});
+  // a damaged entry is rebuilt rather than reported
+  if(auto image = DFAImage::open(path(k, "dfa"))) {
+    hits_++;
+    return image->toAutomaton();
+  }
+  misses_++;
+
+  Parser parser(construction);
+  auto nfa = parser.parseAutomaton(pattern, errFunc);
+  if(!nfa) return {};
+  auto dfa = nfa->buildDFA().prune();
+  // the passes after parsing report what is wrong with it
+  if(!dfa.isDFA()) return nfa;
+  dfa = dfa.minimize();
+  put(k, "dfa", DFAImage::build(dfa));
+  return dfa;
+}
@@ -0,0 +1,68 @@
+#ifndef OPAL_PIPELINE_COMPILECACHE_H_
+#define OPAL_PIPELINE_COMPILECACHE_H_
+
+#include "parser/parse_regex.h"
+#include "state/Automaton.h"
+
+#include <cstddef>
+#include <functional>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// compiler output kept on disk, one file per entry named <key>.<name>
+// keys are a hash of everything that decides the output and the opal version,
+// so an entry never goes stale, a change just looks up a different key
+// entries are written to a temporary file and renamed into place, so builds
+// sharing a cache never read half an entry
+class CompileCache {
+public:
+  using ErrorFunc = std::function<void(std::string_view msg)>;
+
+private:
+  std::string dir_;
+  size_t hits_ = 0;
+  size_t misses_ = 0;
+
+public:
+  // creates `dir` if it isn't there
+  explicit CompileCache(std::string dir);
+
+  // hex hash of `parts` in order and common::version
+  static std::string key(const std::vector<std::string>& parts);
+
+  std::string path(const std::string& key, const std::string& name) const {
+    return dir_ + "/" + key + "." + name;
+  }
+  std::optional<std::string> get(
+      const std::string& key,
+      const std::string& name) const;
+  bool put(
+      const std::string& key,
+      const std::string& name,
+      std::string_view contents) const;
+  // copies between an entry and the file at `path`, false if the source
+  // can't be read
+  bool getFile(
+      const std::string& key,
+      const std::string& name,
+      const std::string& path) const;
+  bool putFile(
+      const std::string& key,
+      const std::string& name,
+      const std::string& path) const;
+
+  // the minimized DFA of `pattern`, read from a cached DFAImage when there is
+  // one. patterns that don't parse are reported and not cached
+  std::optional<Automaton> patternDFA(
+      const std::string& pattern,
+      Parser::Construction construction,
+      ErrorFunc errFunc = {});
+
+  // lookups of patternDFA
+  size_t hits() const { return hits_; }
+  size_t misses() const { return misses_; }
+};
+
+#endif
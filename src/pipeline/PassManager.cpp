@@ -0,0 +1,165 @@
+#include "PassManager.h"
+
+#include "CompileCache.h"
+#include "dot/Dot.h"
+
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+#include <sys/resource.h>
+
+static long peakMemoryKB() {
+  struct rusage usage;
+  if(getrusage(RUSAGE_SELF, &usage) != 0) return 0;
+  // kilobytes on linux, bytes on darwin
+#ifdef __APPLE__
+  return usage.ru_maxrss / 1024;
+#else
+  return usage.ru_maxrss;
+#endif
+}
+
+bool PassManager::run(PipelineState& state, ErrorFunc errFunc) {
+  runs_++;
+  stats_.clear();
+  for(const auto& [name, pass] : passes_) {
+    long peakBefore = peakMemoryKB();
+    auto start = std::chrono::steady_clock::now();
+    bool ok = pass(state, errFunc);
+    auto stop = std::chrono::steady_clock::now();
+
+    PassStats ps;
+    ps.name = name;
+    ps.milliseconds =
+        std::chrono::duration<double, std::milli>(stop - start).count();
+    ps.peakGrowthKB = peakMemoryKB() - peakBefore;
+    if(state.states) {
+      ps.states = state.states->size();
+      ps.transitions = state.states->edgeCount();
+    }
+    stats_.push_back(ps);
+
+    if(!ok) return false;
+    if(options_.dumpDot && state.states) dump(state, name);
+  }
+  return true;
+}
+
+void PassManager::dump(PipelineState& state, const std::string& name) {
+  std::string basename = options_.dumpPrefix + name + std::to_string(runs_);
+  std::string dotName = basename + ".dot";
+  auto g = state.states->toGraph(name);
+  std::ofstream out(dotName);
+  out << g->toString() << "\n";
+  out.close();
+  if(options_.dumpPng) {
+    std::string pngName = basename + ".png";
+    system(std::string("dot -Tpng " + dotName + " -o " + pngName).c_str());
+  }
+}
+
+std::string PassManager::statsToString() const {
+  std::stringstream ss;
+  for(const auto& ps : stats_) {
+    ss << "  " << std::left << std::setw(16) << ps.name << std::right
+       << std::fixed << std::setprecision(3) << std::setw(10)
+       << ps.milliseconds << "ms " << std::setw(8) << ps.states
+       << " states " << std::setw(8) << ps.transitions << " transitions "
+       << std::setw(8) << ps.peakGrowthKB << "KB peak growth\n";
+  }
+  return ss.str();
+}
+
+PassManager PassManager::standard(Options options) {
+  PassManager pm(std::move(options));
+
+  auto construction = pm.options_.construction;
+  auto cacheDir = pm.options_.cacheDir;
+  pm.addPass("parse", [=](PipelineState& ps, const ErrorFunc& errFunc) {
+    Parser p(construction);
+    if(ps.patterns.empty()) {
+      ps.states = p.parseAutomaton(ps.regex, errFunc);
+      if(!ps.states) {
+        if(errFunc) errFunc("error parsing regex: '" + ps.regex + "'");
+        return false;
+      }
+      return true;
+    }
+
+    std::optional<CompileCache> cache;
+    if(!cacheDir.empty()) cache.emplace(cacheDir);
+    // a pattern that doesn't parse is reported and left out of the set, as an
+    // empty automaton that never matches so the ids of the others stay the
+    // same as their index in ps.patterns
+    std::vector<Automaton> automata;
+    for(const auto& pattern : ps.patterns) {
+      auto a = cache ? cache->patternDFA(pattern, construction, errFunc)
+                     : p.parseAutomaton(pattern, errFunc);
+      if(!a) {
+        if(errFunc) errFunc("error parsing regex: '" + pattern + "'");
+        automata.emplace_back();
+        continue;
+      }
+      automata.push_back(std::move(*a));
+    }
+    ps.states = Automaton::unionOf(automata);
+    return true;
+  });
+  pm.addPass("remove-epsilons", [](PipelineState& ps, const ErrorFunc&) {
+    ps.states = ps.states->removeEpsilons();
+    return true;
+  });
+  pm.addPass("determinize", [](PipelineState& ps, const ErrorFunc&) {
+    ps.states = ps.states->buildDFA();
+    return true;
+  });
+  pm.addPass("prune-dfa", [](PipelineState& ps, const ErrorFunc& errFunc) {
+    ps.states = ps.states->prune();
+    if(!ps.states->isDFA()) {
+      if(!errFunc) return false;
+      if(ps.patterns.empty()) {
+        errFunc("error converting regex: '" + ps.regex + "'");
+        return false;
+      }
+      std::string patterns;
+      std::string sep;
+      for(const auto& pattern : ps.patterns) {
+        patterns += sep + "'" + pattern + "'";
+        sep = ", ";
+      }
+      errFunc("error converting patterns: " + patterns);
+      return false;
+    }
+    return true;
+  });
+  pm.addPass("minimize", [](PipelineState& ps, const ErrorFunc&) {
+    ps.states = ps.states->minimize();
+    return true;
+  });
+  pm.addPass("literals", [](PipelineState& ps, const ErrorFunc&) {
+    ps.literals = ps.states->requiredLiterals();
+    return true;
+  });
+  pm.addPass("compile", [](PipelineState& ps, const ErrorFunc&) {
+    ps.compiled = ps.states->compile();
+    return true;
+  });
+  if(pm.options_.search) {
+    pm.addPass("compile-search", [](PipelineState& ps, const ErrorFunc&) {
+      auto minimal = [](const Automaton& nfa) {
+        return nfa.buildDFA().prune().minimize();
+      };
+      ps.compiledForward =
+          minimal(ps.states->unanchored()).compile(MatchMode::Earliest);
+      ps.compiledReverse = minimal(ps.states->reversed().unanchored())
+                               .compile(MatchMode::Reverse);
+      return true;
+    });
+  }
+
+  return pm;
+}
+
+PassManager PassManager::standard() { return standard(Options()); }
@@ -0,0 +1,98 @@
+#ifndef OPAL_PIPELINE_PASSMANAGER_H_
+#define OPAL_PIPELINE_PASSMANAGER_H_
+
+#include "codegen/Instruction.h"
+#include "parser/parse_regex.h"
+#include "state/Automaton.h"
+#include "state/Literals.h"
+
+#include <functional>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+// everything a pass can read or produce, passes fill it in as they go
+struct PipelineState {
+  std::string regex;
+  // set instead of `regex` to build one automaton for all of them, accepts
+  // are tagged with the index of the pattern they match. patterns that don't
+  // parse are reported and never match
+  std::vector<std::string> patterns;
+  std::optional<Automaton> states;
+  std::optional<RequiredLiterals> literals;
+  std::optional<CompiledRegex> compiled;
+  // MatchMode::Earliest over `.*` and the pattern, and MatchMode::Reverse over
+  // `.*` and the reversed pattern, see Searcher
+  std::optional<CompiledRegex> compiledForward;
+  std::optional<CompiledRegex> compiledReverse;
+};
+
+struct PassStats {
+  std::string name;
+  double milliseconds = 0;
+  // how far the pass raised the peak resident set size of the process, 0 when
+  // it stayed under the peak of something that ran before it
+  long peakGrowthKB = 0;
+  size_t states = 0;
+  size_t transitions = 0;
+};
+
+// runs a list of named passes over a PipelineState, recording how long each
+// one took and how big the automaton is afterwards
+// DOT snapshots are only written when asked for, so a normal run never
+// touches the filesystem or forks
+class PassManager {
+public:
+  using ErrorFunc = std::function<void(std::string_view msg)>;
+  // returns false if the pipeline can't continue, after reporting why
+  using Pass = std::function<bool(PipelineState&, const ErrorFunc&)>;
+
+  struct Options {
+    // write a DOT file of the states after every pass
+    bool dumpDot = false;
+    // also render every DOT file with `dot -Tpng`, forks once per dump
+    bool dumpPng = false;
+    // dumps are named <dumpPrefix><pass name><run number>.dot
+    std::string dumpPrefix;
+    // how the parse pass builds the nfa
+    Parser::Construction construction = Parser::Construction::Thompson;
+    // also compile the forward and reverse matchers for unanchored search
+    bool search = false;
+    // when set, the DFA of each of `PipelineState::patterns` is kept in a
+    // CompileCache there, so only new or changed patterns are compiled alone
+    std::string cacheDir;
+  };
+
+private:
+  Options options_;
+  std::vector<std::pair<std::string, Pass>> passes_;
+  std::vector<PassStats> stats_;
+  size_t runs_ = 0;
+
+public:
+  PassManager() = default;
+  explicit PassManager(Options options) : options_(std::move(options)) {}
+
+  void addPass(std::string name, Pass pass) {
+    passes_.emplace_back(std::move(name), std::move(pass));
+  }
+
+  // runs every pass in order, stopping at the first one that fails
+  // stats are replaced with the ones from this run
+  bool run(PipelineState& state, ErrorFunc errFunc = {});
+
+  const std::vector<PassStats>& stats() const { return stats_; }
+  std::string statsToString() const;
+
+  // parse -> remove-epsilons -> determinize -> prune -> minimize -> literals
+  //   -> compile [-> compile-search]
+  static PassManager standard(Options options);
+  static PassManager standard();
+
+private:
+  void dump(PipelineState& state, const std::string& passName);
+};
+
+#endif
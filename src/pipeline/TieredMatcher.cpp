@@ -0,0 +1,102 @@
+#include "TieredMatcher.h"
+
+#include "common/ThreadPool.h"
+
+#include <utility>
+
+TieredMatcher::TieredMatcher(common::ThreadPool& pool, Options options)
+    : pool_(pool), options_(std::move(options)) {}
+
+TieredMatcher::~TieredMatcher() { waitForPromotions(); }
+
+std::optional<TieredMatcher::PatternId> TieredMatcher::add(
+    const std::string& pattern,
+    ErrorFunc errFunc) {
+  Parser parser(options_.construction);
+  auto nfa = parser.parseAutomaton(pattern, errFunc);
+  if(!nfa) return {};
+  entries_.push_back(std::make_unique<Entry>(pattern, std::move(*nfa)));
+  return entries_.size() - 1;
+}
+
+long TieredMatcher::match(PatternId pattern, const char* input, long length) {
+  auto& entry = *entries_[pattern];
+  if(auto compiled = entry.compiled.load(std::memory_order_acquire))
+    return compiled->match(input, length);
+
+  // only cold patterns are counted, a promoted one has nothing left to decide
+  uint64_t calls = entry.calls.fetch_add(1, std::memory_order_relaxed) + 1;
+  uint64_t bytes =
+      entry.bytes.fetch_add(uint64_t(length), std::memory_order_relaxed) +
+      uint64_t(length);
+  if(calls >= options_.promoteAfterCalls || bytes >= options_.promoteAfterBytes)
+    queuePromotion(entry);
+
+  std::lock_guard<std::mutex> lock(entry.interpretedMutex);
+  return entry.interpreted.match(input, length);
+}
+
+void TieredMatcher::promote(PatternId pattern) {
+  queuePromotion(*entries_[pattern]);
+}
+
+void TieredMatcher::queuePromotion(Entry& entry) {
+  if(entry.queued.exchange(true)) return;
+  auto future = pool_.submit([&entry]() {
+    auto compiled = compile(entry.pattern, entry.nfa);
+    // a pattern that doesn't make a DFA stays interpreted
+    if(!compiled) return;
+    entry.owned = std::move(compiled);
+    entry.compiled.store(entry.owned.get(), std::memory_order_release);
+  });
+  std::lock_guard<std::mutex> lock(pendingMutex_);
+  pending_.push_back(std::move(future));
+}
+
+void TieredMatcher::waitForPromotions() {
+  std::vector<std::future<void>> pending;
+  {
+    std::lock_guard<std::mutex> lock(pendingMutex_);
+    pending.swap(pending_);
+  }
+  for(auto& f : pending)
+    f.wait();
+}
+
+TieredMatcher::PatternStats TieredMatcher::stats(PatternId pattern) const {
+  const auto& entry = *entries_[pattern];
+  PatternStats stats;
+  stats.calls = entry.calls.load(std::memory_order_relaxed);
+  stats.bytes = entry.bytes.load(std::memory_order_relaxed);
+  auto compiled = entry.compiled.load(std::memory_order_acquire);
+  stats.promoted = compiled != nullptr;
+  if(!compiled) return stats;
+  if(compiled->shiftAnd) stats.engine = Engine::ShiftAnd;
+  else if(compiled->jit) stats.engine = Engine::JIT;
+  else stats.engine = Engine::DenseDFA;
+  return stats;
+}
+
+std::unique_ptr<TieredMatcher::Compiled> TieredMatcher::compile(
+    const std::string& pattern,
+    const Automaton& nfa) {
+  auto dfa = nfa.buildDFA().prune();
+  if(!dfa.isDFA()) return nullptr;
+  dfa = dfa.minimize();
+
+  auto compiled = std::make_unique<Compiled>();
+  DenseDFA dense(dfa);
+  // one bit per char of the pattern, whatever construction tier 0 uses
+  Parser parser(Parser::Construction::Glushkov);
+  if(auto glushkov = parser.parseAutomaton(pattern)) {
+    ShiftAnd shiftAnd(*glushkov);
+    if(shiftAnd.fasterThan(dense)) {
+      compiled->shiftAnd.emplace(std::move(shiftAnd));
+      return compiled;
+    }
+  }
+  auto regex = dfa.compile();
+  compiled->jit = JITRegex::compile(regex);
+  if(!compiled->jit) compiled->dense.emplace(std::move(dense));
+  return compiled;
+}
@@ -0,0 +1,127 @@
+#ifndef OPAL_PIPELINE_TIEREDMATCHER_H_
+#define OPAL_PIPELINE_TIEREDMATCHER_H_
+
+#include "codegen/JITRegex.h"
+#include "parser/parse_regex.h"
+#include "state/DenseDFA.h"
+#include "state/PikeVM.h"
+#include "state/ShiftAnd.h"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace common {
+class ThreadPool;
+}
+
+// matches many patterns, only paying for full compilation on the ones that
+// are used a lot
+// a pattern starts out simulated by a PikeVM built straight from its NFA,
+// which costs next to nothing to set up. calls and bytes matched are counted
+// per pattern and once either passes its threshold the pattern is
+// determinized, minimized and compiled to native code on the pool. patterns
+// whose DFA is large enough that ShiftAnd::fasterThan says so run Shift-And
+// over their Glushkov automaton instead. calls switch to the compiled matcher
+// as soon as it is published
+// match is thread safe. the PikeVM isn't, so calls to the same cold pattern
+// take turns, compiled patterns take no lock
+class TieredMatcher {
+public:
+  using PatternId = size_t;
+  using ErrorFunc = std::function<void(std::string_view msg)>;
+
+  struct Options {
+    // promote a pattern after this many calls, or this many bytes matched
+    uint64_t promoteAfterCalls = 1000;
+    uint64_t promoteAfterBytes = uint64_t(1) << 20;
+    Parser::Construction construction = Parser::Construction::Thompson;
+  };
+
+  enum class Engine { PikeVM, ShiftAnd, JIT, DenseDFA };
+
+  // counts stop once a pattern is promoted
+  struct PatternStats {
+    uint64_t calls = 0;
+    uint64_t bytes = 0;
+    bool promoted = false;
+    Engine engine = Engine::PikeVM;
+  };
+
+private:
+  // the promoted form, exactly one is set. native code where it can be had
+  // and the dense table everywhere else, unless Shift-And beats both
+  struct Compiled {
+    std::optional<ShiftAnd> shiftAnd;
+    std::optional<JITRegex> jit;
+    std::optional<DenseDFA> dense;
+    long match(const char* input, long length) const {
+      if(shiftAnd) return shiftAnd->match(input, length);
+      return jit ? jit->match(input, length) : dense->match(input, length);
+    }
+  };
+
+  struct Entry {
+    std::string pattern;
+    Automaton nfa;
+    std::mutex interpretedMutex;
+    PikeVM interpreted;
+    std::atomic<uint64_t> calls{0};
+    std::atomic<uint64_t> bytes{0};
+    std::atomic<bool> queued{false};
+    // written once by the promotion, then published through `compiled`
+    std::unique_ptr<Compiled> owned;
+    std::atomic<const Compiled*> compiled{nullptr};
+
+    Entry(std::string p, Automaton a)
+        : pattern(std::move(p)), nfa(a), interpreted(std::move(a)) {}
+  };
+
+  common::ThreadPool& pool_;
+  Options options_;
+  std::vector<std::unique_ptr<Entry>> entries_;
+  std::mutex pendingMutex_;
+  std::vector<std::future<void>> pending_;
+
+public:
+  explicit TieredMatcher(common::ThreadPool& pool)
+      : TieredMatcher(pool, Options()) {}
+  TieredMatcher(common::ThreadPool& pool, Options options);
+  // waits for promotions still running on the pool
+  ~TieredMatcher();
+  TieredMatcher(const TieredMatcher& other) = delete;
+  TieredMatcher& operator=(const TieredMatcher& other) = delete;
+
+  // not thread safe, add every pattern before matching from several threads
+  std::optional<PatternId> add(
+      const std::string& pattern,
+      ErrorFunc errFunc = {});
+
+  // same contract as the generated matchers, the length of the longest prefix
+  // of input that matches `pattern` or -1
+  long match(PatternId pattern, const char* input, long length);
+
+  // promotes `pattern` now, whatever its counts
+  void promote(PatternId pattern);
+  // waits until every promotion queued so far is published
+  void waitForPromotions();
+
+  PatternStats stats(PatternId pattern) const;
+  size_t size() const { return entries_.size(); }
+
+private:
+  void queuePromotion(Entry& entry);
+  static std::unique_ptr<Compiled> compile(
+      const std::string& pattern,
+      const Automaton& nfa);
+};
+
+#endif
@@ -0,0 +1,160 @@
+#include "common/MappedFile.h"
+#include "common/ThreadPool.h"
+#include "pipeline/PassManager.h"
+#include "state/Searcher.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <future>
+#include <iostream>
+#include <string>
+#include <vector>
+
+static void usage() {
+  std::cerr << "usage: scanner [--threads n] [--chunk-mb n] [--count] "
+               "[--glushkov] (pattern | -e pattern...) file...\n";
+}
+
+// a matching line, the line number is counted from the start of its chunk
+struct Hit {
+  long line;
+  // where the leftmost match in the line starts, from the start of the file
+  // Searcher::search finds the same match as DenseDFA::search
+  long offset;
+  const char* begin;
+  const char* end;
+};
+
+struct ChunkResult {
+  std::vector<Hit> hits;
+  long lines = 0;
+};
+
+// [begin, end) starts at the start of a line and ends after a newline or at
+// the end of the file
+// the forward DFA runs over the rest of the chunk rather than line by line,
+// only the line where the earliest match ends has to be searched since a match
+// inside an earlier line would have ended first
+static ChunkResult scanChunk(
+    const Searcher& searcher,
+    const common::MappedFile& file,
+    const char* begin,
+    const char* end) {
+  file.willNeed(begin, end);
+  ChunkResult result;
+  long lines = 0;
+  for(const char* line = begin; line < end;) {
+    long matchEnd = searcher.forward().earliestMatch(line, end - line);
+    if(matchEnd < 0) break;
+    // the line with the last byte of the match in it
+    const char* last = line + std::max(matchEnd - 1, 0L);
+    auto newline = static_cast<const char*>(memrchr(line, '\n', last - line));
+    const char* lineStart = newline ? newline + 1 : line;
+    lines += std::count(line, lineStart, '\n');
+
+    newline =
+        static_cast<const char*>(memchr(lineStart, '\n', end - lineStart));
+    const char* lineEnd = newline ? newline : end;
+    auto m = searcher.search(lineStart, lineEnd - lineStart);
+    if(m.found()) {
+      result.hits.push_back(
+          {lines, (lineStart - file.begin()) + m.start, lineStart, lineEnd});
+    }
+    line = lineEnd + 1;
+    lines++;
+  }
+  result.lines = std::count(begin, end, '\n') + (end[-1] != '\n');
+  return result;
+}
+
+int main(int argc, char** argv) {
+  PassManager::Options options;
+  size_t nThreads = 0;
+  size_t chunkSize = size_t(4) << 20;
+  bool countOnly = false;
+  std::vector<std::string> patterns;
+  std::vector<std::string> paths;
+  for(int i = 1; i < argc; i++) {
+    std::string arg(argv[i]);
+    bool hasValue = i + 1 < argc;
+    if(arg == "--threads" && hasValue) nThreads = std::stoul(argv[++i]);
+    else if(arg == "--chunk-mb" && hasValue)
+      chunkSize = std::max(1ul, std::stoul(argv[++i])) << 20;
+    else if(arg == "--count") countOnly = true;
+    else if(arg == "--glushkov")
+      options.construction = Parser::Construction::Glushkov;
+    else if(arg == "-e" && hasValue) patterns.push_back(argv[++i]);
+    else paths.push_back(arg);
+  }
+  // without -e the first argument is the pattern, like grep
+  if(patterns.empty() && !paths.empty()) {
+    patterns.push_back(paths.front());
+    paths.erase(paths.begin());
+  }
+  if(patterns.empty() || paths.empty()) {
+    usage();
+    return 2;
+  }
+
+  auto pm = PassManager::standard(options);
+  PipelineState state;
+  state.patterns = patterns;
+  if(!pm.run(state, [](auto msg) { std::cerr << msg << "\n"; })) return 2;
+  Searcher searcher(*state.states);
+
+  common::ThreadPool pool(nThreads);
+  bool anyMatched = false;
+  bool anyFailed = false;
+  std::string out;
+  for(const auto& path : paths) {
+    common::MappedFile file;
+    if(!file.open(path)) {
+      std::cerr << "scanner: " << path << ": " << strerror(errno) << "\n";
+      anyFailed = true;
+      continue;
+    }
+
+    // chunks end just past a newline so no line is split between two
+    std::vector<std::future<ChunkResult>> chunks;
+    for(const char* begin = file.begin(); begin < file.end();) {
+      const char* end = file.end();
+      if(size_t(end - begin) > chunkSize) {
+        auto newline = static_cast<const char*>(
+            memchr(begin + chunkSize, '\n', end - (begin + chunkSize)));
+        if(newline) end = newline + 1;
+      }
+      chunks.push_back(pool.submit([&searcher, &file, begin, end]() {
+        return scanChunk(searcher, file, begin, end);
+      }));
+      begin = end;
+    }
+
+    // results are written in file order, as each chunk finishes
+    std::string prefix = paths.size() > 1 ? path + ":" : "";
+    long line = 1;
+    long count = 0;
+    for(auto& chunk : chunks) {
+      auto result = chunk.get();
+      count += long(result.hits.size());
+      if(!countOnly) {
+        for(const auto& hit : result.hits) {
+          out += prefix;
+          out += std::to_string(line + hit.line) + ":";
+          out += std::to_string(hit.offset) + ":";
+          out.append(hit.begin, hit.end);
+          out += "\n";
+        }
+        fwrite(out.data(), 1, out.size(), stdout);
+        out.clear();
+      }
+      line += result.lines;
+    }
+    if(countOnly) std::cout << prefix << count << "\n";
+    anyMatched = anyMatched || count != 0;
+  }
+
+  if(anyFailed) return 2;
+  return anyMatched ? 0 : 1;
+}
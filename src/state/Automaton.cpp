@@ -0,0 +1,511 @@
+#include "Automaton.h"
+
+#include "ByteClasses.h"
+#include "DFA.h"
+#include "codegen/Instruction.h"
+#include "dot/Dot.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include <queue>
+#include <tuple>
+#include <unordered_map>
+
+static size_t wordsFor(size_t bytes) {
+  return (bytes + sizeof(uint64_t) - 1) / sizeof(uint64_t);
+}
+
+Automaton::Automaton(const Automaton& other)
+    : nStates_(other.nStates_), nEdges_(other.nEdges_), entry_(other.entry_),
+      arena_(std::make_unique<Word[]>(other.arenaWords_)),
+      edgesOffset_(other.edgesOffset_), acceptOffset_(other.acceptOffset_),
+      arenaWords_(other.arenaWords_), names_(other.names_),
+      patterns_(other.patterns_) {
+  if(arenaWords_) std::memcpy(arena_.get(), other.arena_.get(), arenaBytes());
+}
+Automaton& Automaton::operator=(const Automaton& other) {
+  if(this != &other) *this = Automaton(other);
+  return *this;
+}
+
+Automaton Automaton::Builder::build() const {
+  Automaton a;
+  a.nStates_ = size();
+  a.nEdges_ = edges_.size();
+  a.entry_ = entry_;
+
+  size_t offsetWords = wordsFor((a.nStates_ + 1) * sizeof(uint32_t));
+  size_t edgeWords = wordsFor(a.nEdges_ * sizeof(Edge));
+  size_t acceptWords = (a.nStates_ + 63) / 64;
+  a.edgesOffset_ = offsetWords;
+  a.acceptOffset_ = offsetWords + edgeWords;
+  a.arenaWords_ = offsetWords + edgeWords + acceptWords;
+  // value initialized, so padding and unused accept bits are zero
+  a.arena_ = std::make_unique<Word[]>(a.arenaWords_);
+
+  // counting sort of the edges by their source state
+  auto offsets = reinterpret_cast<uint32_t*>(a.arena_.get());
+  for(const auto& e : edges_)
+    offsets[e.from + 1]++;
+  for(size_t s = 0; s < a.nStates_; s++)
+    offsets[s + 1] += offsets[s];
+  auto edges = reinterpret_cast<Edge*>(a.arena_.get() + a.edgesOffset_);
+  std::vector<uint32_t> next(offsets, offsets + a.nStates_);
+  for(const auto& e : edges_)
+    edges[next[e.from]++] = e.edge;
+
+  auto accepts = a.arena_.get() + a.acceptOffset_;
+  for(size_t s = 0; s < a.nStates_; s++) {
+    if(isAccept_[s]) accepts[s / 64] |= Word(1) << (s % 64);
+  }
+
+  if(hasNames_) a.names_ = names_;
+  if(hasPatterns_) {
+    a.patterns_ = patterns_;
+    for(auto& ps : a.patterns_) {
+      std::sort(ps.begin(), ps.end());
+      ps.erase(std::unique(ps.begin(), ps.end()), ps.end());
+    }
+  }
+  return a;
+}
+
+Automaton Automaton::fromStateList(const StateList& sl) {
+  Builder b;
+  std::unordered_map<const State*, StateId> ids;
+  for(const auto& s : sl.states()) {
+    auto id = b.addState(s->isAccept(), s->name());
+    b.addPatterns(id, s->patterns());
+    ids.emplace(s.get(), id);
+  }
+  for(const auto& s : sl.states()) {
+    auto from = ids.at(s.get());
+    for(const auto& t : s->transitions()) {
+      assert(t.isEpsilon() || t.label().size() == 1);
+      Label label = t.isEpsilon() ? Epsilon : (unsigned char)t.label()[0];
+      b.addEdge(from, ids.at(t.toState()), label);
+    }
+  }
+  if(sl.entry()) b.setEntry(ids.at(sl.entry()));
+  return b.build();
+}
+
+StateList Automaton::toStateList() const {
+  StateList sl;
+  std::vector<State*> states;
+  states.reserve(size());
+  for(StateId s = 0; s < size(); s++) {
+    auto state = std::make_unique<State>(std::string(name(s)), isAccept(s));
+    state->setPatterns(patterns(s));
+    states.push_back(state.get());
+    if(s == entry()) sl.addEntry(std::move(state));
+    else sl.add(std::move(state));
+  }
+  for(StateId s = 0; s < size(); s++) {
+    for(const auto& e : edges(s)) {
+      if(e.isEpsilon()) states[s]->addTransition(states[e.to]);
+      else states[s]->addTransition(states[e.to], char(e.label));
+    }
+  }
+  return sl;
+}
+
+Automaton Automaton::unionOf(const std::vector<Automaton>& patterns) {
+  // a new entry with an epsilon edge to the entry of every pattern
+  Builder b;
+  auto entry = b.addState();
+  b.setEntry(entry);
+  for(PatternId p = 0; p < patterns.size(); p++) {
+    const auto& a = patterns[p];
+    StateId base = StateId(b.size());
+    for(StateId s = 0; s < a.size(); s++) {
+      auto id = b.addState(a.isAccept(s), std::string(a.name(s)));
+      if(a.isAccept(s)) b.addPattern(id, p);
+    }
+    for(StateId s = 0; s < a.size(); s++) {
+      for(const auto& e : a.edges(s))
+        b.addEdge(base + s, base + e.to, e.label);
+    }
+    if(a.size() != 0) b.addEdge(entry, base + a.entry());
+  }
+  return b.build();
+}
+
+Automaton Automaton::unanchored() const {
+  // a new entry looping on every byte, with an epsilon edge to the old one
+  Builder b;
+  for(StateId s = 0; s < size(); s++)
+    b.addPatterns(b.addState(isAccept(s), std::string(name(s))), patterns(s));
+  auto entry = b.addState();
+  b.setEntry(entry);
+  for(StateId s = 0; s < size(); s++) {
+    for(const auto& e : edges(s))
+      b.addEdge(s, e.to, e.label);
+  }
+  for(Label c = 0; c < 256; c++)
+    b.addEdge(entry, entry, c);
+  if(size() != 0) b.addEdge(entry, entry_);
+  return b.build();
+}
+
+Automaton Automaton::reversed() const {
+  // a new entry with an epsilon edge to every old accept, the old entry is
+  // the only accept
+  Builder b;
+  for(StateId s = 0; s < size(); s++)
+    b.addState(s == entry_, std::string(name(s)));
+  auto entry = b.addState();
+  b.setEntry(entry);
+  for(StateId s = 0; s < size(); s++) {
+    if(isAccept(s)) b.addEdge(entry, s);
+    for(const auto& e : edges(s))
+      b.addEdge(e.to, s, e.label);
+  }
+  return b.build();
+}
+
+std::vector<std::vector<Automaton::StateId>> Automaton::epsilonClosures()
+    const {
+  // walk the epsilon transitions once from each state, marking states with
+  // the id of the walk instead of clearing a visited set every time
+  std::vector<std::vector<StateId>> closures(size());
+  std::vector<size_t> visited(size(), 0);
+  std::vector<StateId> toExplore;
+  for(StateId s = 0; s < size(); s++) {
+    auto& closure = closures[s];
+    toExplore.push_back(s);
+    while(!toExplore.empty()) {
+      auto next = toExplore.back();
+      toExplore.pop_back();
+      if(visited[next] == s + 1) continue;
+      visited[next] = s + 1;
+      closure.push_back(next);
+      for(const auto& e : edges(next)) {
+        if(e.isEpsilon()) toExplore.push_back(e.to);
+      }
+    }
+    std::sort(closure.begin(), closure.end());
+  }
+  return closures;
+}
+
+Automaton Automaton::removeEpsilons() const {
+  Builder b;
+  if(size() == 0) return b.build();
+
+  // old id to new id, states are numbered as they are reached
+  constexpr StateId Unmapped = StateId(-1);
+  std::vector<StateId> newId(size(), Unmapped);
+  std::vector<StateId> worklist;
+  auto idFor = [&](StateId s) {
+    if(newId[s] == Unmapped) {
+      newId[s] = b.addState(false, std::string(name(s)));
+      worklist.push_back(s);
+    }
+    return newId[s];
+  };
+  b.setEntry(idFor(entry()));
+
+  // the closure walk marks states with the id of the walk instead of clearing
+  // a visited set every time
+  std::vector<size_t> visited(size(), 0);
+  size_t walk = 0;
+  std::vector<StateId> toExplore;
+  std::vector<Edge> consuming;
+  for(size_t i = 0; i < worklist.size(); i++) {
+    StateId s = worklist[i];
+    walk++;
+    bool accept = false;
+    toExplore.push_back(s);
+    while(!toExplore.empty()) {
+      auto next = toExplore.back();
+      toExplore.pop_back();
+      if(visited[next] == walk) continue;
+      visited[next] = walk;
+      accept = accept || isAccept(next);
+      b.addPatterns(newId[s], patterns(next));
+      for(const auto& e : edges(next)) {
+        if(e.isEpsilon()) toExplore.push_back(e.to);
+        else consuming.push_back(e);
+      }
+    }
+
+    // different paths through the closure can give the same edge
+    std::sort(consuming.begin(), consuming.end(), [](auto lhs, auto rhs) {
+      return std::tie(lhs.label, lhs.to) < std::tie(rhs.label, rhs.to);
+    });
+    auto last = std::unique(
+        consuming.begin(),
+        consuming.end(),
+        [](auto lhs, auto rhs) {
+          return lhs.label == rhs.label && lhs.to == rhs.to;
+        });
+    StateId from = newId[s];
+    b.setAccept(from, accept);
+    for(auto it = consuming.begin(); it != last; it++)
+      b.addEdge(from, idFor(it->to), it->label);
+    consuming.clear();
+  }
+  return b.build();
+}
+
+Automaton Automaton::prune() const {
+  Builder b;
+  if(size() == 0) return b.build();
+
+  // forward from the entry
+  std::vector<bool> reachable(size(), false);
+  std::vector<StateId> toExplore = {entry()};
+  while(!toExplore.empty()) {
+    auto s = toExplore.back();
+    toExplore.pop_back();
+    if(reachable[s]) continue;
+    reachable[s] = true;
+    for(const auto& e : edges(s))
+      toExplore.push_back(e.to);
+  }
+
+  // backward from the accepts, over the reachable states only
+  std::vector<std::vector<StateId>> into(size());
+  for(StateId s = 0; s < size(); s++) {
+    if(!reachable[s]) continue;
+    for(const auto& e : edges(s))
+      into[e.to].push_back(s);
+    if(isAccept(s)) toExplore.push_back(s);
+  }
+  std::vector<bool> useful(size(), false);
+  while(!toExplore.empty()) {
+    auto s = toExplore.back();
+    toExplore.pop_back();
+    if(useful[s]) continue;
+    useful[s] = true;
+    for(auto from : into[s])
+      toExplore.push_back(from);
+  }
+  useful[entry()] = true;
+
+  // kept states keep their order
+  constexpr StateId Unmapped = StateId(-1);
+  std::vector<StateId> newId(size(), Unmapped);
+  for(StateId s = 0; s < size(); s++) {
+    if(!useful[s]) continue;
+    newId[s] = b.addState(isAccept(s), std::string(name(s)));
+    b.addPatterns(newId[s], patterns(s));
+  }
+  for(StateId s = 0; s < size(); s++) {
+    if(!useful[s]) continue;
+    for(const auto& e : edges(s)) {
+      if(useful[e.to]) b.addEdge(newId[s], newId[e.to], e.label);
+    }
+  }
+  b.setEntry(newId[entry()]);
+  return b.build();
+}
+
+bool Automaton::isDFA() const {
+  if(size() == 0) return false;
+  for(StateId s = 0; s < size(); s++) {
+    bool seen[256] = {};
+    for(const auto& e : edges(s)) {
+      if(e.isEpsilon() || seen[e.label]) return false;
+      seen[e.label] = true;
+    }
+  }
+  return true;
+}
+
+// a set of N states as its ids in increasing order, so a DFA state costs its
+// own size and not a bit for every state of N
+using IdList = std::vector<Automaton::StateId>;
+struct IdListHash {
+  size_t operator()(const IdList& ids) const {
+    uint64_t h = 0x9E3779B97F4A7C15ULL ^ ids.size();
+    for(auto id : ids) {
+      h ^= id;
+      h *= 0xFF51AFD7ED558CCDULL;
+      h ^= h >> 32;
+    }
+    return size_t(h);
+  }
+};
+
+/*
+subset construction of DFA D from NFA N
+
+start state is the set of states reachable without consuming from the start
+state of N
+
+D's states are only built when they are reached from the start state, so the
+work done is proportional to the size of D and not to the 2^n subsets of N
+
+accept states of D are any states that have an accept state from N, and match
+every pattern their N states match
+
+sets of N states are sorted id lists interned by hash, the epsilon closure of
+every N state is computed once up front
+
+*/
+Automaton Automaton::determinize() const {
+  const Automaton& N = *this;
+  Builder D;
+  // with no states there is no entry, the DFA is a lone state that never
+  // matches
+  if(N.size() == 0) {
+    D.setEntry(D.addState());
+    return D.build();
+  }
+
+  auto closures = N.epsilonClosures();
+
+  // contains mapping of set of N states to D's states
+  std::unordered_map<IdList, StateId, IdListHash> NSetToD;
+  // D's states that have not had their transitions built yet
+  std::queue<std::pair<const IdList*, StateId>> worklist;
+
+  // find the D state for `nSet`, building it if this is the first time we
+  // have reached it. the set is only copied when it is new
+  auto getOrAddState = [&N, &D, &NSetToD, &worklist](const IdList& nSet) {
+    auto it = NSetToD.find(nSet);
+    if(it != NSetToD.end()) return it->second;
+
+    // if any of the states in 'nSet' are an accept state, dState is an accept
+    bool isAccept = false;
+    std::string label;
+    std::string sep;
+    for(auto s : nSet) {
+      isAccept = isAccept || N.isAccept(s);
+      auto name = N.name(s);
+      label += sep + std::string(name);
+      if(!name.empty()) sep = ",";
+    }
+    StateId dState = D.addState(isAccept, std::move(label));
+    for(auto s : nSet)
+      D.addPatterns(dState, N.patterns(s));
+
+    // node based map, so the key stays put while it waits in the worklist
+    it = NSetToD.emplace(nSet, dState).first;
+    worklist.push({&it->first, dState});
+    return dState;
+  };
+
+  // D's start state is every state reachable without consuming from N's start
+  D.setEntry(getOrAddState(closures[N.entry()]));
+
+  // one set per byte, reused for every D state
+  std::vector<IdList> dfaTransferTable(256);
+  std::vector<Label> touched;
+
+  // for each state, build the DFA transfer table, which is all states
+  // reachable for a given transition
+  // once thats built, we can translate that set into another dfa state, which
+  // becomes our toState
+  while(!worklist.empty()) {
+    auto [nfaSet, dfaState] = worklist.front();
+    worklist.pop();
+
+    for(auto s : *nfaSet) {
+      // for each non epsilon transition, add the closure of its target
+      for(const auto& e : N.edges(s)) {
+        if(e.isEpsilon()) continue;
+        auto& target = dfaTransferTable[e.label];
+        const auto& closure = closures[e.to];
+        if(target.empty()) touched.push_back(e.label);
+        target.insert(target.end(), closure.begin(), closure.end());
+      }
+    }
+    // in byte order, so the states are always built in the same order
+    std::sort(touched.begin(), touched.end());
+    for(auto label : touched) {
+      auto& target = dfaTransferTable[label];
+      std::sort(target.begin(), target.end());
+      target.erase(std::unique(target.begin(), target.end()), target.end());
+      D.addEdge(dfaState, getOrAddState(target), label);
+      target.clear();
+    }
+    touched.clear();
+  }
+
+  return D.build();
+}
+
+Automaton Automaton::buildDFA() const {
+  auto classes = ByteClasses::fromAutomaton(*this);
+  return classes.expand(classes.compress(*this).determinize());
+}
+
+CompiledRegex Automaton::compile() const {
+  return compile(MatchMode::Longest);
+}
+
+CompiledRegex Automaton::compile(MatchMode mode) const {
+  assert(isDFA());
+  // only the anchored matcher says which patterns matched
+  CompiledRegex cr(hasPatterns() && mode == MatchMode::Longest, mode);
+
+  std::vector<InstructionList*> blocks;
+  blocks.reserve(size());
+  for(StateId s = 0; s < size(); s++) {
+    blocks.push_back(cr.getNewBlockForState(s));
+  }
+
+  for(StateId s = 0; s < size(); s++) {
+    auto block = blocks[s];
+
+    if(isAccept(s)) {
+      // get the first state, which should be a nop
+      Instruction* nop = block->head;
+      assert(dynamic_cast<NOP*>(nop) != nullptr);
+      // add after the nop
+      auto store = cr.storeMatch();
+      block->addAfter(store, nop);
+      if(cr.reportsPatterns()) {
+        auto set = cr.addPatternSet(patterns(s));
+        block->addAfter(cr.storePatternSet(set), store);
+      }
+      if(mode == MatchMode::Earliest) block->addAfter(cr.jumpToDone(), store);
+    }
+
+    // add the transitions
+    for(const auto& e : edges(s)) {
+      Instruction* target = blocks[e.to]->head;
+      block->addBack(cr.matchChar(char(e.label), target));
+    }
+  }
+
+  // finish the entry block first, then the rest in state order
+  cr.finishBlock(blocks[entry()]);
+  for(StateId s = 0; s < size(); s++) {
+    if(s != entry()) cr.finishBlock(blocks[s]);
+  }
+
+  return cr;
+}
+
+std::unique_ptr<dot::Graph> Automaton::toGraph(std::string_view name) const {
+  auto g = std::make_unique<dot::Graph>(name);
+  g->setDirected(true);
+  g->setAttribute("rankdir", "LR");
+
+  std::vector<dot::Graph::Vertex*> nodes;
+  nodes.reserve(size());
+  for(StateId s = 0; s < size(); s++) {
+    auto v = g->addVertex();
+    v->setAttribute("label", "\"" + std::string(this->name(s)) + "\"");
+    if(isAccept(s)) v->setAttribute("shape", "doublecircle");
+    nodes.push_back(v);
+  }
+
+  auto entryDummy = g->addVertex();
+  entryDummy->setAttribute("shape", "point");
+  if(size() != 0) g->addEdge(entryDummy, nodes[entry()]);
+
+  for(StateId s = 0; s < size(); s++) {
+    for(const auto& e : edges(s)) {
+      auto edge = g->addEdge(nodes[s], nodes[e.to]);
+      std::string label = e.isEpsilon() ? "ε" : std::string(1, char(e.label));
+      edge->setAttribute("label", "\"" + label + "\"");
+    }
+  }
+  return g;
+}
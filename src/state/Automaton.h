@@ -0,0 +1,200 @@
+#ifndef OPAL_STATE_AUTOMATON_H_
+#define OPAL_STATE_AUTOMATON_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+class CompiledRegex;
+class StateList;
+namespace dot {
+class Graph;
+}
+enum class MatchMode;
+struct RequiredLiterals;
+
+// a compact, immutable automaton
+// states are integer ids and the transitions leaving them are stored in CSR
+// form: the edges of state `s` are edges[offsets[s], offsets[s + 1]). labels
+// are single bytes, or `Epsilon`. every array lives in one arena allocation
+// and is found by its offset into it, so copying an Automaton is a memcpy
+// state names are only for debugging and are kept in an optional side table
+class Automaton {
+public:
+  using StateId = uint32_t;
+  using Label = uint16_t;
+  using PatternId = uint32_t;
+  static constexpr Label Epsilon = 256;
+
+  struct Edge {
+    Label label;
+    StateId to;
+
+    bool isEpsilon() const { return label == Epsilon; }
+  };
+
+  struct EdgeRange {
+    const Edge* begin_;
+    const Edge* end_;
+    const Edge* begin() const { return begin_; }
+    const Edge* end() const { return end_; }
+    size_t size() const { return size_t(end_ - begin_); }
+    bool empty() const { return begin_ == end_; }
+  };
+
+  class Builder;
+
+private:
+  using Word = uint64_t;
+
+  size_t nStates_ = 0;
+  size_t nEdges_ = 0;
+  StateId entry_ = 0;
+  // offsets, edges, and the accept bitmap, each starting on a word boundary
+  std::unique_ptr<Word[]> arena_;
+  size_t edgesOffset_ = 0;
+  size_t acceptOffset_ = 0;
+  size_t arenaWords_ = 0;
+  // empty when the states have no names
+  std::vector<std::string> names_;
+  // pattern ids of each accept state, sorted. empty unless the automaton was
+  // built from several patterns
+  std::vector<std::vector<PatternId>> patterns_;
+
+public:
+  Automaton() = default;
+  ~Automaton() = default;
+  Automaton(const Automaton& other);
+  Automaton(Automaton&& other) noexcept = default;
+  Automaton& operator=(const Automaton& other);
+  Automaton& operator=(Automaton&& other) noexcept = default;
+
+  static Automaton fromStateList(const StateList& sl);
+  StateList toStateList() const;
+
+  // one automaton matching any of `patterns`, the accepts of pattern `i` are
+  // tagged with pattern id `i`
+  static Automaton unionOf(const std::vector<Automaton>& patterns);
+
+  // matches `.*` followed by this, so a DFA of it finds where matches end
+  // anywhere in the input in one pass
+  Automaton unanchored() const;
+  // matches the reverse of every string this matches, every edge is flipped
+  // and the accepts become the entry. pattern ids are dropped
+  Automaton reversed() const;
+
+  size_t size() const { return nStates_; }
+  size_t edgeCount() const { return nEdges_; }
+  StateId entry() const { return entry_; }
+  bool isAccept(StateId s) const { return (accepts()[s / 64] >> (s % 64)) & 1; }
+  EdgeRange edges(StateId s) const {
+    return {edgeArray() + offsets()[s], edgeArray() + offsets()[s + 1]};
+  }
+  std::string_view name(StateId s) const {
+    return names_.empty() ? std::string_view() : std::string_view(names_[s]);
+  }
+  // patterns matched on reaching `s`, always empty for single pattern
+  // automata
+  const std::vector<PatternId>& patterns(StateId s) const {
+    static const std::vector<PatternId> none;
+    return patterns_.empty() ? none : patterns_[s];
+  }
+  bool hasPatterns() const { return !patterns_.empty(); }
+  // bytes used by the arena, the name table is not included
+  size_t arenaBytes() const { return arenaWords_ * sizeof(Word); }
+
+  // all states reachable without consuming from each state, including itself,
+  // in increasing order. lists rather than bitsets, so an automaton without
+  // epsilon edges costs one id per state and not n bits
+  std::vector<std::vector<StateId>> epsilonClosures() const;
+
+  // an equivalent automaton without epsilon transitions, each state takes the
+  // consuming edges and accept flag of its whole closure. only the entry and
+  // states entered by a consuming edge are kept, and only if reachable
+  // linear in the number of edges plus the closure sizes
+  Automaton removeEpsilons() const;
+
+  // drops the states that can't be reached from the entry or can't reach an
+  // accept, along with the edges into them. the entry is always kept
+  Automaton prune() const;
+
+  // no epsilon transitions and no state has two edges with the same label
+  bool isDFA() const;
+  // subset construction, only the subsets reachable from the entry are built
+  Automaton determinize() const;
+  // determinize over the byte classes of this automaton, so each DFA state
+  // only looks at one byte per class, then expand back to bytes
+  Automaton buildDFA() const;
+  // merge equivalent states of a DFA, using Hopcroft's partition refinement
+  // states that can never reach an accept are dropped, see Minimize.cpp
+  Automaton minimize() const;
+
+  // literals every match contains, must be a DFA and should be minimized, see
+  // Literals.cpp
+  RequiredLiterals requiredLiterals() const;
+
+  CompiledRegex compile() const;
+  CompiledRegex compile(MatchMode mode) const;
+
+  std::unique_ptr<dot::Graph> toGraph(std::string_view name) const;
+
+private:
+  const uint32_t* offsets() const {
+    return reinterpret_cast<const uint32_t*>(arena_.get());
+  }
+  const Edge* edgeArray() const {
+    return reinterpret_cast<const Edge*>(arena_.get() + edgesOffset_);
+  }
+  const Word* accepts() const { return arena_.get() + acceptOffset_; }
+};
+
+// accumulates states and edges in any order, then lays them out as an
+// Automaton
+class Automaton::Builder {
+private:
+  struct PendingEdge {
+    StateId from;
+    Edge edge;
+  };
+  std::vector<bool> isAccept_;
+  std::vector<std::string> names_;
+  bool hasNames_ = false;
+  std::vector<PendingEdge> edges_;
+  StateId entry_ = 0;
+  std::vector<std::vector<PatternId>> patterns_;
+  bool hasPatterns_ = false;
+
+public:
+  StateId addState(bool isAccept = false, std::string name = "") {
+    isAccept_.push_back(isAccept);
+    hasNames_ = hasNames_ || !name.empty();
+    names_.push_back(std::move(name));
+    patterns_.emplace_back();
+    return StateId(isAccept_.size() - 1);
+  }
+  void setAccept(StateId s, bool isAccept = true) { isAccept_[s] = isAccept; }
+  bool isAccept(StateId s) const { return isAccept_[s]; }
+  // duplicates are fine, the lists are sorted and deduped by `build`
+  void addPattern(StateId s, PatternId p) {
+    patterns_[s].push_back(p);
+    hasPatterns_ = true;
+  }
+  void addPatterns(StateId s, const std::vector<PatternId>& ps) {
+    patterns_[s].insert(patterns_[s].end(), ps.begin(), ps.end());
+    hasPatterns_ = hasPatterns_ || !ps.empty();
+  }
+  void setEntry(StateId s) { entry_ = s; }
+  StateId entry() const { return entry_; }
+  void addEdge(StateId from, StateId to, Label label = Epsilon) {
+    edges_.push_back({from, {label, to}});
+  }
+  size_t size() const { return isAccept_.size(); }
+
+  // edges keep the order they were added in
+  Automaton build() const;
+};
+
+#endif
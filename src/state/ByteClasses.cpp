@@ -0,0 +1,96 @@
+#include "ByteClasses.h"
+
+#include <set>
+#include <unordered_map>
+#include <vector>
+
+void ByteClasses::split(const ByteSet& set) {
+  // every (old class, in set) pair becomes a new class, numbered in the order
+  // of its smallest byte
+  std::array<int16_t, 512> newClass;
+  newClass.fill(-1);
+  int16_t next = 0;
+  for(size_t b = 0; b < 256; b++) {
+    size_t inSet = (set[b / 64] >> (b % 64)) & 1;
+    auto& cls = newClass[classOf_[b] * 2 + inSet];
+    if(cls == -1) cls = next++;
+    classOf_[b] = uint8_t(cls);
+  }
+  nClasses_ = size_t(next);
+}
+
+void ByteClasses::add(const Automaton& a) {
+  // the bytes leading from each state to each target are what has to be
+  // distinguished, many states share the same sets so dedupe them first
+  std::set<ByteSet> sets;
+  std::unordered_map<Automaton::StateId, ByteSet> byTarget;
+  for(Automaton::StateId s = 0; s < a.size(); s++) {
+    for(const auto& e : a.edges(s)) {
+      if(e.isEpsilon()) continue;
+      auto& set = byTarget[e.to];
+      set[e.label / 64] |= uint64_t(1) << (e.label % 64);
+    }
+    for(const auto& [to, set] : byTarget)
+      sets.insert(set);
+    byTarget.clear();
+  }
+
+  for(const auto& set : sets) {
+    split(set);
+    // can't get any finer than one class per byte
+    if(nClasses_ == 256) break;
+  }
+}
+
+unsigned char ByteClasses::representative(size_t cls) const {
+  for(size_t b = 0; b < 256; b++) {
+    if(classOf_[b] == cls) return (unsigned char)b;
+  }
+  return 0;
+}
+
+Automaton ByteClasses::compress(const Automaton& a) const {
+  Automaton::Builder b;
+  for(Automaton::StateId s = 0; s < a.size(); s++)
+    b.addPatterns(
+        b.addState(a.isAccept(s), std::string(a.name(s))),
+        a.patterns(s));
+  b.setEntry(a.entry());
+
+  std::set<std::pair<Automaton::Label, Automaton::StateId>> seen;
+  for(Automaton::StateId s = 0; s < a.size(); s++) {
+    for(const auto& e : a.edges(s)) {
+      Automaton::Label label =
+          e.isEpsilon() ? Automaton::Epsilon : classOf(e.label);
+      if(seen.insert({label, e.to}).second) b.addEdge(s, e.to, label);
+    }
+    seen.clear();
+  }
+  return b.build();
+}
+
+Automaton ByteClasses::expand(const Automaton& a) const {
+  // bytes of each class, in increasing order
+  std::vector<std::vector<unsigned char>> bytes(size());
+  for(size_t c = 0; c < 256; c++)
+    bytes[classOf_[c]].push_back((unsigned char)c);
+
+  Automaton::Builder b;
+  for(Automaton::StateId s = 0; s < a.size(); s++)
+    b.addPatterns(
+        b.addState(a.isAccept(s), std::string(a.name(s))),
+        a.patterns(s));
+  b.setEntry(a.entry());
+
+  for(Automaton::StateId s = 0; s < a.size(); s++) {
+    for(const auto& e : a.edges(s)) {
+      if(e.isEpsilon()) {
+        b.addEdge(s, e.to);
+        continue;
+      }
+      for(auto c : bytes[e.label])
+        b.addEdge(s, e.to, c);
+    }
+  }
+  return b.build();
+}
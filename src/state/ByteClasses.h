@@ -0,0 +1,50 @@
+#ifndef OPAL_STATE_BYTECLASSES_H_
+#define OPAL_STATE_BYTECLASSES_H_
+
+#include "Automaton.h"
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+// partitions the 256 byte values into equivalence classes, two bytes are in
+// the same class when no transition of any automaton added can tell them apart
+// classes are numbered from 0 in the order of their smallest byte
+class ByteClasses {
+private:
+  std::array<uint8_t, 256> classOf_;
+  size_t nClasses_ = 1;
+
+public:
+  // every byte in one class
+  ByteClasses() { classOf_.fill(0); }
+
+  static ByteClasses fromAutomaton(const Automaton& a) {
+    ByteClasses bc;
+    bc.add(a);
+    return bc;
+  }
+
+  // refine the classes so they also distinguish every byte `a` does, call
+  // once per automaton to get classes shared by a whole pattern set
+  void add(const Automaton& a);
+
+  size_t size() const { return nClasses_; }
+  uint8_t classOf(unsigned char c) const { return classOf_[c]; }
+  // the byte to class map, for use in transition tables
+  const std::array<uint8_t, 256>& map() const { return classOf_; }
+  // the smallest byte in class `cls`
+  unsigned char representative(size_t cls) const;
+
+  // rewrite `a` so its labels are class ids, edges from one state to the same
+  // target that fall in the same class are merged
+  Automaton compress(const Automaton& a) const;
+  // undo `compress`, every class edge becomes one edge per byte in the class
+  Automaton expand(const Automaton& a) const;
+
+private:
+  using ByteSet = std::array<uint64_t, 4>;
+  void split(const ByteSet& set);
+};
+
+#endif
@@ -0,0 +1,239 @@
+#include "ByteScanner.h"
+
+#include <cstring>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define OPAL_X86_SIMD
+#include <immintrin.h>
+#endif
+
+ByteScanner::ByteScanner(const ByteSet& set) : set_(set) {
+  size_t n = size();
+  if(n == 0) kind_ = Kind::Empty;
+  else if(n == 256) kind_ = Kind::All;
+  else if(n <= bytes_.size()) {
+    kind_ = n == 1 ? Kind::One : Kind::Few;
+    for(size_t b = 0; b < 256; b++) {
+      if(set_[b]) bytes_[nBytes_++] = (unsigned char)b;
+    }
+  } else {
+    kind_ = Kind::Nibbles;
+    // high nibbles that allow the same low nibbles share a bucket. there are
+    // only 8 bucket bits, past that the rest are merged into the last bucket
+    // which then allows some bytes that aren't in the set
+    std::vector<uint16_t> bucketLows;
+    for(size_t high = 0; high < 16; high++) {
+      uint16_t lows = 0;
+      for(size_t low = 0; low < 16; low++) {
+        if(set_[high << 4 | low]) lows |= uint16_t(1) << low;
+      }
+      if(lows == 0) continue;
+      size_t bucket = 0;
+      while(bucket < bucketLows.size() && bucketLows[bucket] != lows)
+        bucket++;
+      if(bucket == bucketLows.size()) {
+        if(bucket < 8) bucketLows.push_back(lows);
+        else {
+          bucket = 7;
+          bucketLows[7] |= lows;
+          exact_ = false;
+        }
+      }
+      highNibbles_[high] |= uint8_t(1) << bucket;
+    }
+    for(size_t bucket = 0; bucket < bucketLows.size(); bucket++) {
+      for(size_t low = 0; low < 16; low++) {
+        if((bucketLows[bucket] >> low) & 1)
+          lowNibbles_[low] |= uint8_t(1) << bucket;
+      }
+    }
+  }
+
+#ifdef OPAL_X86_SIMD
+  hasAVX2_ = __builtin_cpu_supports("avx2");
+  hasSSSE3_ = __builtin_cpu_supports("ssse3");
+#endif
+}
+
+size_t ByteScanner::size() const {
+  size_t n = 0;
+  for(auto b : set_)
+    n += b;
+  return n;
+}
+
+const char* ByteScanner::find(const char* begin, const char* end) const {
+  switch(kind_) {
+    case Kind::Empty: return end;
+    case Kind::All: return begin;
+    case Kind::One: {
+      auto p = std::memchr(begin, bytes_[0], size_t(end - begin));
+      return p ? static_cast<const char*>(p) : end;
+    }
+    case Kind::Few: return findFew(begin, end);
+    case Kind::Nibbles: return findNibbles(begin, end);
+  }
+  return end;
+}
+
+const char* ByteScanner::findScalar(const char* begin, const char* end) const {
+  for(auto p = begin; p != end; p++) {
+    if(set_[(unsigned char)*p]) return p;
+  }
+  return end;
+}
+
+#ifdef OPAL_X86_SIMD
+
+// the simd loops stop at the last full vector and return where they got to,
+// the caller finishes the tail a byte at a time
+
+__attribute__((target("avx2"))) static const char* findFewAVX2(
+    const std::array<unsigned char, 3>& bytes,
+    size_t n,
+    const char* p,
+    const char* end) {
+  __m256i b0 = _mm256_set1_epi8(char(bytes[0]));
+  __m256i b1 = _mm256_set1_epi8(char(bytes[1]));
+  __m256i b2 = _mm256_set1_epi8(char(bytes[n > 2 ? 2 : 0]));
+  for(; end - p >= 32; p += 32) {
+    __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+    __m256i eq = _mm256_or_si256(
+        _mm256_or_si256(_mm256_cmpeq_epi8(v, b0), _mm256_cmpeq_epi8(v, b1)),
+        _mm256_cmpeq_epi8(v, b2));
+    uint32_t mask = uint32_t(_mm256_movemask_epi8(eq));
+    if(mask) return p + __builtin_ctz(mask);
+  }
+  return p;
+}
+
+__attribute__((target("sse2"))) static const char* findFewSSE2(
+    const std::array<unsigned char, 3>& bytes,
+    size_t n,
+    const char* p,
+    const char* end) {
+  __m128i b0 = _mm_set1_epi8(char(bytes[0]));
+  __m128i b1 = _mm_set1_epi8(char(bytes[1]));
+  __m128i b2 = _mm_set1_epi8(char(bytes[n > 2 ? 2 : 0]));
+  for(; end - p >= 16; p += 16) {
+    __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+    __m128i eq = _mm_or_si128(
+        _mm_or_si128(_mm_cmpeq_epi8(v, b0), _mm_cmpeq_epi8(v, b1)),
+        _mm_cmpeq_epi8(v, b2));
+    uint32_t mask = uint32_t(_mm_movemask_epi8(eq));
+    if(mask) return p + __builtin_ctz(mask);
+  }
+  return p;
+}
+
+// `found` returns the first candidate in `mask` that is really in the set
+template <typename Found>
+static const char* firstCandidate(const char* p, uint32_t mask, Found found) {
+  while(mask) {
+    auto candidate = p + __builtin_ctz(mask);
+    if(found(candidate)) return candidate;
+    mask &= mask - 1;
+  }
+  return nullptr;
+}
+
+__attribute__((target("avx2"))) static const char* findNibblesAVX2(
+    const uint8_t* lows,
+    const uint8_t* highs,
+    bool exact,
+    const ByteScanner::ByteSet& set,
+    const char* p,
+    const char* end) {
+  // pshufb looks up within each 128 bit lane, so both lanes get the table
+  __m256i lowTable = _mm256_broadcastsi128_si256(
+      _mm_load_si128(reinterpret_cast<const __m128i*>(lows)));
+  __m256i highTable = _mm256_broadcastsi128_si256(
+      _mm_load_si128(reinterpret_cast<const __m128i*>(highs)));
+  __m256i nibble = _mm256_set1_epi8(0x0f);
+  __m256i zero = _mm256_setzero_si256();
+  auto inSet = [exact, &set](const char* c) {
+    return exact || set[(unsigned char)*c];
+  };
+  for(; end - p >= 32; p += 32) {
+    __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+    __m256i low = _mm256_shuffle_epi8(lowTable, _mm256_and_si256(v, nibble));
+    __m256i high = _mm256_shuffle_epi8(
+        highTable,
+        _mm256_and_si256(_mm256_srli_epi16(v, 4), nibble));
+    __m256i none = _mm256_cmpeq_epi8(_mm256_and_si256(low, high), zero);
+    uint32_t mask = ~uint32_t(_mm256_movemask_epi8(none));
+    if(auto found = firstCandidate(p, mask, inSet)) return found;
+  }
+  return p;
+}
+
+__attribute__((target("ssse3"))) static const char* findNibblesSSSE3(
+    const uint8_t* lows,
+    const uint8_t* highs,
+    bool exact,
+    const ByteScanner::ByteSet& set,
+    const char* p,
+    const char* end) {
+  __m128i lowTable = _mm_load_si128(reinterpret_cast<const __m128i*>(lows));
+  __m128i highTable = _mm_load_si128(reinterpret_cast<const __m128i*>(highs));
+  __m128i nibble = _mm_set1_epi8(0x0f);
+  __m128i zero = _mm_setzero_si128();
+  auto inSet = [exact, &set](const char* c) {
+    return exact || set[(unsigned char)*c];
+  };
+  for(; end - p >= 16; p += 16) {
+    __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+    __m128i low = _mm_shuffle_epi8(lowTable, _mm_and_si128(v, nibble));
+    __m128i high = _mm_shuffle_epi8(
+        highTable,
+        _mm_and_si128(_mm_srli_epi16(v, 4), nibble));
+    __m128i none = _mm_cmpeq_epi8(_mm_and_si128(low, high), zero);
+    uint32_t mask = ~uint32_t(_mm_movemask_epi8(none)) & 0xffff;
+    if(auto found = firstCandidate(p, mask, inSet)) return found;
+  }
+  return p;
+}
+
+#endif
+
+const char* ByteScanner::findFew(const char* begin, const char* end) const {
+  auto p = begin;
+#ifdef OPAL_X86_SIMD
+  // a loop that stops with a full vector left stopped on a match
+  if(hasAVX2_) {
+    p = findFewAVX2(bytes_, nBytes_, p, end);
+    if(end - p >= 32) return p;
+  }
+  p = findFewSSE2(bytes_, nBytes_, p, end);
+  if(end - p >= 16) return p;
+#endif
+  return findScalar(p, end);
+}
+
+const char* ByteScanner::findNibbles(const char* begin, const char* end) const {
+  auto p = begin;
+#ifdef OPAL_X86_SIMD
+  if(hasAVX2_) {
+    p = findNibblesAVX2(
+        lowNibbles_.data(),
+        highNibbles_.data(),
+        exact_,
+        set_,
+        p,
+        end);
+    if(end - p >= 32) return p;
+  }
+  if(hasSSSE3_) {
+    p = findNibblesSSSE3(
+        lowNibbles_.data(),
+        highNibbles_.data(),
+        exact_,
+        set_,
+        p,
+        end);
+    if(end - p >= 16) return p;
+  }
+#endif
+  return findScalar(p, end);
+}
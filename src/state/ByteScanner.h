@@ -0,0 +1,53 @@
+#ifndef OPAL_STATE_BYTESCANNER_H_
+#define OPAL_STATE_BYTESCANNER_H_
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+// finds the next byte in a buffer that belongs to a fixed set
+// picks the cheapest way to look for the set it was given:
+//   one byte          memchr
+//   two or three      one pcmpeqb per byte, 16 or 32 bytes at a time
+//   anything else     pshufb lookups on the low and high nibble of every byte
+//                     (shufti), with a table lookup to confirm candidates when
+//                     the set doesn't fit in 8 nibble buckets
+// AVX2 and SSSE3 are used when the cpu has them, everything falls back to a
+// byte at a time table lookup
+class ByteScanner {
+public:
+  using ByteSet = std::array<bool, 256>;
+
+private:
+  enum class Kind { Empty, All, One, Few, Nibbles };
+
+  Kind kind_ = Kind::Empty;
+  ByteSet set_;
+  std::array<unsigned char, 3> bytes_ = {};
+  size_t nBytes_ = 0;
+  // bucket bits for each low nibble and each high nibble, a byte may be in
+  // the set when the two share a bit
+  alignas(16) std::array<uint8_t, 16> lowNibbles_ = {};
+  alignas(16) std::array<uint8_t, 16> highNibbles_ = {};
+  // every byte the nibble tables allow is in the set, no need to confirm
+  bool exact_ = true;
+  bool hasAVX2_ = false;
+  bool hasSSSE3_ = false;
+
+public:
+  ByteScanner() { set_.fill(false); }
+  explicit ByteScanner(const ByteSet& set);
+
+  // the first byte in [begin, end) in the set, or end
+  const char* find(const char* begin, const char* end) const;
+
+  bool contains(unsigned char c) const { return set_[c]; }
+  size_t size() const;
+
+private:
+  const char* findScalar(const char* begin, const char* end) const;
+  const char* findFew(const char* begin, const char* end) const;
+  const char* findNibbles(const char* begin, const char* end) const;
+};
+
+#endif
@@ -3,9 +3,11 @@
 
 #ifndef DFA_H_
 #define DFA_H_
+#include "Literals.h"
 #include "codegen/Instruction.h"
 #include "dot/Dot.h"
 
+#include <cstdint>
 #include <functional>
 #include <iostream>
 #include <memory>
@@ -66,6 +68,9 @@ private:
   std::vector<Transition> transitions_;
 
   bool isAccept_;
+  // which patterns an accept state matches, only used when several patterns
+  // share one automaton. kept sorted
+  std::vector<uint32_t> patterns_;
 
 public:
   State(const std::string& name, bool isAccept = false)
@@ -98,54 +103,23 @@ public:
     }
   }
 
+  void clearTransitions() { transitions_.clear(); }
+
   CONST_MEMBER_FUNC_GETTER(name, name_);
   CONST_MEMBER_FUNC_GETTER_TYPED(const auto&, transitions, transitions_);
   CONST_MEMBER_FUNC_GETTER(isAccept, isAccept_);
 
   void setAccept(bool e = true) { isAccept_ = e; }
 
-  // each state is unique and no epsilon
+  CONST_MEMBER_FUNC_GETTER_TYPED(const auto&, patterns, patterns_);
+  void setPatterns(std::vector<uint32_t> patterns) {
+    patterns_ = std::move(patterns);
+  }
+
+  // each label is unique and no epsilon
   CONST_MEMBER_FUNC(bool, isDFAEligible);
 };
 
-// class AssembledRegex {
-// public:
-//   struct Instruction {
-//     std::string inst;
-//     bool isLabeled;
-//   };
-
-// private:
-//   std::vector<Instruction> instructions_;
-
-// public:
-//   void addInstruction(std::string inst, bool isLabeled = false);
-
-//   std::string toString();
-// };
-
-// class JITRegex {
-// public:
-//   using MatchFunction = long (*)(char *, long);
-
-// private:
-//   void *memory;
-//   size_t memSize;
-//   MatchFunction funcPtr;
-
-// public:
-// JITRegex(const AssembledRegex& assembled) {
-//   // TODO: mmap code to map assembled code
-// }
-//   MatchFunction function() {return funcPtr;}
-//   long operator()(char *input, long n) {
-//     if (funcPtr)
-//       return funcPtr(input, n);
-//     else
-//       return -1;
-//   }
-// };
-
 class StateList {
 private:
   std::vector<std::unique_ptr<State>> states_;
@@ -207,6 +181,18 @@ public:
   CONST_MEMBER_FUNC(bool, isDFA);
   CONST_MEMBER_FUNC(StateList, buildDFA);
 
+  struct MinimizeStats {
+    size_t statesBefore;
+    size_t statesAfter;
+  };
+  // merge equivalent states of a DFA, using Hopcroft's partition refinement
+  // states that can never reach an accept are dropped
+  MinimizeStats minimize();
+
+  // literals every match contains, determinizes and minimizes a copy first
+  // if this is not a DFA
+  CONST_MEMBER_FUNC(RequiredLiterals, requiredLiterals);
+
   CONST_MEMBER_FUNC(CompiledRegex, compile);
 
   // std::string toC(std::string nameSuffix = "", std::string namePrefix="rr");
@@ -0,0 +1,232 @@
+#include "DFAImage.h"
+
+#include "DFA.h"
+#include "DenseDFA.h"
+#include "common/utils.h"
+
+#include <cerrno>
+#include <cstring>
+#include <map>
+#include <vector>
+
+static const char Magic[8] = {'o', 'p', 'a', 'l', 'd', 'f', 'a', '\0'};
+static const uint32_t ByteOrder = 0x01020304;
+
+static uint64_t align8(uint64_t offset) { return (offset + 7) & ~uint64_t(7); }
+
+template <class T>
+static void put(std::string& image, uint64_t offset, const std::vector<T>& v) {
+  if(!v.empty()) std::memcpy(&image[offset], v.data(), v.size() * sizeof(T));
+}
+
+std::string DFAImage::build(const Automaton& dfa) {
+  DenseDFA dense(dfa);
+  size_t stride = dense.stride();
+  size_t rows = dense.size();
+
+  std::vector<uint8_t> classOf(
+      dense.classes().map().begin(),
+      dense.classes().map().end());
+  std::vector<unsigned char> representative(dense.classes().size());
+  for(size_t cls = 0; cls < representative.size(); cls++)
+    representative[cls] = dense.classes().representative(cls);
+  std::vector<uint32_t> table(rows * stride, DenseDFA::Dead);
+  std::vector<uint64_t> accepts((rows + 63) / 64, 0);
+  for(size_t row = 1; row < rows; row++) {
+    auto s = DenseDFA::StateId(row * stride);
+    for(size_t cls = 0; cls < representative.size(); cls++)
+      table[row * stride + cls] = dense.next(s, representative[cls]);
+    if(dense.isAccept(s)) accepts[row / 64] |= uint64_t(1) << (row % 64);
+  }
+
+  // set 0 is empty, the others are numbered as they are first seen. dfa
+  // state s is row s + 1
+  std::vector<uint32_t> stateSets(rows, 0);
+  std::vector<uint32_t> setOffsets = {0, 0};
+  std::vector<uint32_t> patterns;
+  std::map<std::vector<Automaton::PatternId>, uint32_t> ids = {{{}, 0}};
+  for(Automaton::StateId s = 0; s < dfa.size(); s++) {
+    if(!dfa.isAccept(s)) continue;
+    const auto& ps = dfa.patterns(s);
+    auto [it, inserted] = ids.emplace(ps, uint32_t(setOffsets.size() - 1));
+    if(inserted) {
+      patterns.insert(patterns.end(), ps.begin(), ps.end());
+      setOffsets.push_back(uint32_t(patterns.size()));
+    }
+    stateSets[s + 1] = it->second;
+  }
+
+  Header header = {};
+  std::memcpy(header.magic, Magic, sizeof(Magic));
+  header.version = Version;
+  header.byteOrder = ByteOrder;
+  header.nStates = uint32_t(rows);
+  header.strideShift = uint32_t(__builtin_ctzll(stride));
+  header.start = dense.start();
+  header.nSets = uint32_t(setOffsets.size() - 1);
+  header.nPatternIds = uint32_t(patterns.size());
+  header.classOf = align8(sizeof(Header));
+  header.table = align8(header.classOf + classOf.size());
+  header.accepts = align8(header.table + table.size() * sizeof(uint32_t));
+  header.stateSets = align8(header.accepts + accepts.size() * sizeof(uint64_t));
+  header.setOffsets =
+      align8(header.stateSets + stateSets.size() * sizeof(uint32_t));
+  header.patterns =
+      align8(header.setOffsets + setOffsets.size() * sizeof(uint32_t));
+  header.size = align8(header.patterns + patterns.size() * sizeof(uint32_t));
+
+  std::string image(header.size, '\0');
+  put(image, header.classOf, classOf);
+  put(image, header.table, table);
+  put(image, header.accepts, accepts);
+  put(image, header.stateSets, stateSets);
+  put(image, header.setOffsets, setOffsets);
+  put(image, header.patterns, patterns);
+  header.checksum = common::utils::fnv1a(
+      image.data() + sizeof(Header),
+      image.size() - sizeof(Header));
+  std::memcpy(&image[0], &header, sizeof(Header));
+  return image;
+}
+
+std::string DFAImage::build(const StateList& dfa) {
+  return build(Automaton::fromStateList(dfa));
+}
+
+std::optional<DFAImage> DFAImage::load(
+    const char* data,
+    size_t size,
+    bool verify,
+    ErrorFunc errFunc) {
+  auto fail = [&](const std::string& msg) {
+    if(errFunc) errFunc("bad dfa image: " + msg);
+    return std::nullopt;
+  };
+  if(reinterpret_cast<uintptr_t>(data) % 8 != 0)
+    return fail("not 8 byte aligned");
+  if(size < sizeof(Header)) return fail("too short");
+  auto header = reinterpret_cast<const Header*>(data);
+  if(std::memcmp(header->magic, Magic, sizeof(Magic)) != 0)
+    return fail("not an image");
+  if(header->version != Version)
+    return fail("version " + std::to_string(header->version));
+  if(header->byteOrder != ByteOrder) return fail("wrong byte order");
+  if(header->size != size) return fail("truncated");
+
+  // every section lies inside the image, counts are widened first so they
+  // can't overflow
+  uint64_t rows = header->nStates;
+  if(rows == 0 || header->strideShift > 8) return fail("bad table shape");
+  uint64_t stride = uint64_t(1) << header->strideShift;
+  auto inside = [&](uint64_t offset, uint64_t bytes) {
+    return offset % 8 == 0 && offset <= size && bytes <= size - offset;
+  };
+  if(!inside(header->classOf, 256) ||
+     !inside(header->table, rows * stride * sizeof(uint32_t)) ||
+     !inside(header->accepts, (rows + 63) / 64 * sizeof(uint64_t)) ||
+     !inside(header->stateSets, rows * sizeof(uint32_t)) ||
+     !inside(
+         header->setOffsets,
+         (uint64_t(header->nSets) + 1) * sizeof(uint32_t)) ||
+     !inside(header->patterns, header->nPatternIds * sizeof(uint32_t)))
+    return fail("section out of bounds");
+
+  DFAImage image;
+  image.header_ = header;
+  image.classOf_ = reinterpret_cast<const uint8_t*>(data + header->classOf);
+  image.table_ = reinterpret_cast<const uint32_t*>(data + header->table);
+  image.accepts_ = reinterpret_cast<const uint64_t*>(data + header->accepts);
+  image.stateSets_ =
+      reinterpret_cast<const uint32_t*>(data + header->stateSets);
+  image.setOffsets_ =
+      reinterpret_cast<const uint32_t*>(data + header->setOffsets);
+  image.patterns_ = reinterpret_cast<const uint32_t*>(data + header->patterns);
+  if(!verify) return image;
+
+  auto checksum =
+      common::utils::fnv1a(data + sizeof(Header), size - sizeof(Header));
+  if(checksum != header->checksum) return fail("checksum mismatch");
+  // a matching checksum only rules out damage, the contents still have to
+  // stay inside the tables when matched
+  uint64_t entries = rows * stride;
+  if(header->start >= entries || header->start % stride != 0)
+    return fail("bad start state");
+  for(size_t b = 0; b < 256; b++) {
+    if(image.classOf_[b] >= stride) return fail("bad byte class");
+  }
+  for(uint64_t i = 0; i < entries; i++) {
+    if(image.table_[i] >= entries || image.table_[i] % stride != 0)
+      return fail("bad transition");
+  }
+  for(uint64_t row = 0; row < rows; row++) {
+    if(image.stateSets_[row] >= header->nSets) return fail("bad pattern set");
+  }
+  for(uint64_t set = 0; set < header->nSets; set++) {
+    if(image.setOffsets_[set] > image.setOffsets_[set + 1] ||
+       image.setOffsets_[set + 1] > header->nPatternIds)
+      return fail("bad pattern set");
+  }
+  return image;
+}
+
+std::optional<DFAImage> DFAImage::open(
+    const std::string& path,
+    bool verify,
+    ErrorFunc errFunc) {
+  common::MappedFile file;
+  if(!file.open(path, common::MappedFile::Access::Random)) {
+    if(errFunc) errFunc("can't map " + path + ": " + std::strerror(errno));
+    return std::nullopt;
+  }
+  auto image = load(file.data(), file.size(), verify, errFunc);
+  if(image) image->file_ = std::move(file);
+  return image;
+}
+
+Automaton DFAImage::toAutomaton() const {
+  // row r is state r - 1, and the dead row has no state
+  uint32_t shift = header_->strideShift;
+  Automaton::Builder b;
+  for(size_t row = 1; row < size(); row++) {
+    auto s = b.addState(isAccept(uint32_t(row << shift)));
+    auto set = stateSets_[row];
+    b.addPatterns(
+        s,
+        std::vector<Automaton::PatternId>(setBegin(set), setEnd(set)));
+  }
+  for(size_t row = 1; row < size(); row++) {
+    for(size_t c = 0; c < 256; c++) {
+      uint32_t to = table_[(row << shift) + classOf_[c]];
+      if(to == DenseDFA::Dead) continue;
+      b.addEdge(
+          Automaton::StateId(row - 1),
+          (to >> shift) - 1,
+          Automaton::Label(c));
+    }
+  }
+  b.setEntry((header_->start >> shift) - 1);
+  return b.build();
+}
+
+long DFAImage::match(const char* input, long length, size_t* matchedSet)
+    const {
+  const uint32_t* table = table_;
+  const uint8_t* classOf = classOf_;
+  uint32_t s = header_->start;
+  uint32_t matchedState = s;
+  long longestMatch = isAccept(s) ? 0 : -1;
+  for(long counter = 0; counter < length; counter++) {
+    s = table[s + classOf[(unsigned char)input[counter]]];
+    if(s == DenseDFA::Dead) break;
+    if(isAccept(s)) {
+      longestMatch = counter + 1;
+      matchedState = s;
+    }
+  }
+  if(matchedSet) {
+    *matchedSet = longestMatch >= 0
+                      ? stateSets_[matchedState >> header_->strideShift]
+                      : 0;
+  }
+  return longestMatch;
+}
@@ -0,0 +1,117 @@
+#ifndef OPAL_STATE_DFAIMAGE_H_
+#define OPAL_STATE_DFAIMAGE_H_
+
+#include "Automaton.h"
+#include "common/MappedFile.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <optional>
+#include <string>
+#include <string_view>
+
+class StateList;
+
+// a DFA and its pattern sets in one flat buffer that is matched in place, so
+// a file holding one can be mapped and used with no parsing or copying, and
+// every process mapping it shares the same pages
+// the buffer is a header followed by sections at 8 byte aligned offsets from
+// its start, nothing in it is a pointer:
+//   byte classes   256 x uint8, the class of each byte
+//   table          rows x stride x uint32, as in DenseDFA
+//   accepts        (rows + 63) / 64 x uint64, one bit per row
+//   state sets     rows x uint32, the pattern set of each row
+//   set offsets    (sets + 1) x uint32, set i is patterns[offsets[i],
+//                  offsets[i + 1])
+//   patterns       uint32 pattern ids
+// numbers are in the byte order of the machine that built the image, an image
+// from a machine with the other order is rejected
+class DFAImage {
+public:
+  static constexpr uint32_t Version = 1;
+
+  struct Header {
+    char magic[8];
+    uint32_t version;
+    uint32_t byteOrder;
+    // of the whole image
+    uint64_t size;
+    // common::utils::fnv1a of everything after the header
+    uint64_t checksum;
+    uint32_t nStates;
+    uint32_t strideShift;
+    uint32_t start;
+    uint32_t nSets;
+    uint32_t nPatternIds;
+    uint32_t reserved;
+    // section offsets from the start of the image
+    uint64_t classOf;
+    uint64_t table;
+    uint64_t accepts;
+    uint64_t stateSets;
+    uint64_t setOffsets;
+    uint64_t patterns;
+  };
+
+  using ErrorFunc = std::function<void(std::string_view msg)>;
+
+private:
+  const Header* header_ = nullptr;
+  const uint8_t* classOf_ = nullptr;
+  const uint32_t* table_ = nullptr;
+  const uint64_t* accepts_ = nullptr;
+  const uint32_t* stateSets_ = nullptr;
+  const uint32_t* setOffsets_ = nullptr;
+  const uint32_t* patterns_ = nullptr;
+  // set when the image is a mapped file
+  common::MappedFile file_;
+
+public:
+  // the image of `dfa`, to be written out as is
+  static std::string build(const Automaton& dfa);
+  static std::string build(const StateList& dfa);
+
+  // an image using `data` in place, `data` must be 8 byte aligned and outlive
+  // it. the header and section bounds are always checked, the checksum and
+  // every table entry only with `verify`, which reads the whole image
+  static std::optional<DFAImage> load(
+      const char* data,
+      size_t size,
+      bool verify = true,
+      ErrorFunc errFunc = {});
+  // maps the file at `path` and loads it
+  static std::optional<DFAImage> open(
+      const std::string& path,
+      bool verify = true,
+      ErrorFunc errFunc = {});
+
+  // same contract as the generated matchers, the length of the longest prefix
+  // of input that matches or -1. `matchedSet` gets the pattern set of that
+  // match, set 0 when there isn't one
+  long match(const char* input, long length, size_t* matchedSet = nullptr)
+      const;
+
+  // the DFA the image was built from, with the same state numbers
+  Automaton toAutomaton() const;
+
+  // the pattern ids in set `set`
+  const uint32_t* setBegin(size_t set) const {
+    return patterns_ + setOffsets_[set];
+  }
+  const uint32_t* setEnd(size_t set) const {
+    return patterns_ + setOffsets_[set + 1];
+  }
+
+  // includes the dead state
+  size_t size() const { return header_->nStates; }
+  size_t nSets() const { return header_->nSets; }
+
+private:
+  bool isAccept(uint32_t s) const {
+    size_t row = s >> header_->strideShift;
+    return (accepts_[row / 64] >> (row % 64)) & 1;
+  }
+};
+
+#endif
@@ -0,0 +1,356 @@
+#include "DenseDFA.h"
+
+#include <algorithm>
+#include <cassert>
+#include <sstream>
+#include <sys/uio.h>
+
+DenseDFA::DenseDFA(const Automaton& dfa)
+    : classes_(ByteClasses::fromAutomaton(dfa)) {
+  assert(dfa.isDFA());
+  auto compressed = classes_.compress(dfa);
+
+  while(stride() < classes_.size())
+    strideShift_++;
+  // row 0 is the dead state, dfa state `s` is row `s + 1`
+  nStates_ = compressed.size() + 1;
+  table_.assign(nStates_ << strideShift_, Dead);
+  accepts_.assign((nStates_ + 63) / 64, 0);
+
+  for(Automaton::StateId s = 0; s < compressed.size(); s++) {
+    size_t row = s + 1;
+    if(compressed.isAccept(s)) accepts_[row / 64] |= uint64_t(1) << (row % 64);
+    for(const auto& e : compressed.edges(s)) {
+      table_[(row << strideShift_) + e.label] =
+          StateId((e.to + 1) << strideShift_);
+    }
+  }
+  start_ = StateId((compressed.entry() + 1) << strideShift_);
+
+  prefilter_ = Prefilter(dfa.requiredLiterals());
+  afterPrefix_ = start_;
+  for(unsigned char c : prefilter_.literals().prefix)
+    afterPrefix_ = next(afterPrefix_, c);
+  prefixLength_ = long(prefilter_.literals().prefix.size());
+
+  ByteScanner::ByteSet startBytes;
+  for(size_t c = 0; c < 256; c++)
+    startBytes[c] = next(start_, (unsigned char)c) != Dead;
+  startBytes_ = ByteScanner(startBytes);
+}
+
+DenseDFA::Match DenseDFA::search(const char* input, long length) const {
+  // the empty string matches at the very start
+  if(isAccept(start_)) return {0, run(input, length, start_, 0)};
+  if(!prefilter_.empty() && !prefilter_.mayContainMatch(input, length))
+    return {};
+
+  const char* end = input + length;
+  for(auto p = startBytes_.find(input, end); p != end;
+      p = startBytes_.find(p + 1, end)) {
+    long longestMatch = run(p, end - p, start_, 0);
+    if(longestMatch >= 0) return {p - input, p - input + longestMatch};
+  }
+  return {};
+}
+
+long DenseDFA::earliestMatch(const char* input, long length) const {
+  if(!prefilter_.empty() && !prefilter_.mayContainMatch(input, length))
+    return -1;
+  const uint32_t* table = table_.data();
+  const uint8_t* classOf = classes_.map().data();
+  StateId s = start_;
+  if(isAccept(s)) return 0;
+  for(long counter = 0; counter < length; counter++) {
+    s = table[s + classOf[(unsigned char)input[counter]]];
+    if(s == Dead) break;
+    if(isAccept(s)) return counter + 1;
+  }
+  return -1;
+}
+
+long DenseDFA::reverseMatch(const char* input, long length) const {
+  const uint32_t* table = table_.data();
+  const uint8_t* classOf = classes_.map().data();
+  StateId s = start_;
+  long leftmost = isAccept(s) ? length : -1;
+  for(long counter = length; counter > 0; counter--) {
+    s = table[s + classOf[(unsigned char)input[counter - 1]]];
+    if(s == Dead) break;
+    leftmost = isAccept(s) ? counter - 1 : leftmost;
+  }
+  return leftmost;
+}
+
+bool DenseDFA::feed(Stream& stream, const char* input, long length) const {
+  const uint32_t* table = table_.data();
+  const uint8_t* classOf = classes_.map().data();
+  StateId s = stream.state;
+  long longestMatch = stream.longestMatch;
+  long counter = 0;
+  for(; s != Dead && counter < length; counter++) {
+    s = table[s + classOf[(unsigned char)input[counter]]];
+    longestMatch = isAccept(s) ? stream.consumed + counter + 1 : longestMatch;
+  }
+  stream.state = s;
+  stream.consumed += counter;
+  stream.longestMatch = longestMatch;
+  return s != Dead;
+}
+
+bool DenseDFA::feed(Stream& stream, const struct iovec* iov, int iovcnt) const {
+  for(int i = 0; i < iovcnt && !stream.done(); i++)
+    feed(
+        stream,
+        static_cast<const char*>(iov[i].iov_base),
+        long(iov[i].iov_len));
+  return !stream.done();
+}
+
+template <class Input>
+void DenseDFA::runBatch(size_t n, Input input, long* results) const {
+  const uint32_t* table = table_.data();
+  const uint8_t* classOf = classes_.map().data();
+
+  const char* begin[BatchLanes];
+  long length[BatchLanes];
+  long counter[BatchLanes];
+  long longestMatch[BatchLanes];
+  StateId state[BatchLanes];
+  size_t index[BatchLanes];
+
+  // put the next input the prefilter doesn't reject in lane `l`
+  size_t next = 0;
+  auto fill = [&](size_t l) {
+    for(; next < n; next++) {
+      input(next, begin[l], length[l]);
+      if(!prefilter_.empty() && !prefilter_.mayMatch(begin[l], length[l])) {
+        results[next] = -1;
+        continue;
+      }
+      index[l] = next++;
+      state[l] = afterPrefix_;
+      counter[l] = prefixLength_;
+      longestMatch[l] = isAccept(afterPrefix_) ? prefixLength_ : -1;
+      return true;
+    }
+    return false;
+  };
+  size_t busy = 0;
+  while(busy < BatchLanes && fill(busy))
+    busy++;
+
+  // every lane steps as many bytes as the shortest one has left, up to a
+  // block, with no checks in between. a lane that dies keeps stepping the
+  // dead row, which only leads back to itself, until the end of the block
+  while(busy == BatchLanes) {
+    long steps = BatchBlock;
+    for(size_t l = 0; l < BatchLanes; l++)
+      steps = std::min(steps, length[l] - counter[l]);
+    for(long i = 0; i < steps; i++) {
+      for(size_t l = 0; l < BatchLanes; l++) {
+        unsigned char c = begin[l][counter[l] + i];
+        state[l] = table[state[l] + classOf[c]];
+        longestMatch[l] =
+            isAccept(state[l]) ? counter[l] + i + 1 : longestMatch[l];
+      }
+    }
+    for(size_t l = 0; l < BatchLanes; l++)
+      counter[l] += steps;
+    for(size_t l = 0; l < busy;) {
+      if(counter[l] < length[l] && state[l] != Dead) {
+        l++;
+        continue;
+      }
+      results[index[l]] = longestMatch[l];
+      if(fill(l)) {
+        l++;
+        continue;
+      }
+      // out of inputs, move the last lane here, the rest finish below
+      busy--;
+      begin[l] = begin[busy];
+      length[l] = length[busy];
+      counter[l] = counter[busy];
+      longestMatch[l] = longestMatch[busy];
+      state[l] = state[busy];
+      index[l] = index[busy];
+    }
+  }
+
+  // fewer inputs left than lanes
+  for(size_t l = 0; l < busy; l++) {
+    long m = run(begin[l], length[l], state[l], counter[l]);
+    results[index[l]] = m >= 0 ? m : longestMatch[l];
+  }
+}
+
+void DenseDFA::matchBatch(
+    const char* const* inputs,
+    const long* lengths,
+    size_t n,
+    long* results) const {
+  runBatch(
+      n,
+      [inputs, lengths](size_t i, const char*& begin, long& length) {
+        begin = inputs[i];
+        length = lengths[i];
+      },
+      results);
+}
+
+void DenseDFA::matchBatch(
+    const char* data,
+    const long* offsets,
+    size_t n,
+    long* results) const {
+  runBatch(
+      n,
+      [data, offsets](size_t i, const char*& begin, long& length) {
+        begin = data + offsets[i];
+        length = offsets[i + 1] - offsets[i];
+      },
+      results);
+}
+
+std::string DenseDFA::isAcceptC(
+    const std::string& name,
+    const std::string& s) const {
+  // the row is the state shifted down by the stride
+  std::string row = "(" + s + " >> " + std::to_string(strideShift_) + ")";
+  return "(" + name + "_accepts[" + row + " / 64] >> (" + row +
+         " % 64) & 1)";
+}
+
+std::string DenseDFA::toTablesC(const std::string& name) const {
+  std::stringstream ss;
+  ss << "static const unsigned char " << name << "_classes[256] = {";
+  for(size_t c = 0; c < 256; c++)
+    ss << (c % 32 ? "" : "\n") << unsigned(classes_.map()[c]) << ",";
+  ss << "\n};\n";
+  ss << "static const unsigned " << name << "_table[" << table_.size()
+     << "] = {";
+  for(size_t i = 0; i < table_.size(); i++)
+    ss << (i % 16 ? "" : "\n") << table_[i] << ",";
+  ss << "\n};\n";
+  ss << "static const unsigned long long " << name << "_accepts["
+     << accepts_.size() << "] = {";
+  for(auto word : accepts_)
+    ss << "\n" << word << "ull,";
+  ss << "\n};";
+  return ss.str();
+}
+
+std::string DenseDFA::toStreamC(const std::string& name) const {
+  std::stringstream ss;
+  ss << "struct " << name << "_stream {\n"
+     << "  unsigned state;\n"
+     << "  long consumed;\n"
+     << "  long longestMatch;\n"
+     << "};\n";
+  ss << "void " << name << "_start(struct " << name << "_stream* stream) {\n"
+     << "  unsigned s = " << start_ << ";\n"
+     << "  stream->state = s;\n"
+     << "  stream->consumed = 0;\n"
+     << "  stream->longestMatch = " << isAcceptC(name, "s") << " ? 0 : -1;\n"
+     << "}\n";
+  ss << "int " << name << "_feed(struct " << name
+     << "_stream* stream, const char* input, long length) {\n"
+     << "  unsigned s = stream->state;\n"
+     << "  long longestMatch = stream->longestMatch;\n"
+     << "  long i = 0;\n"
+     << "  for(; s != 0 && i < length; i++) {\n"
+     << "    s = " << name << "_table[s + " << name
+     << "_classes[(unsigned char)input[i]]];\n"
+     << "    if(" << isAcceptC(name, "s")
+     << ") longestMatch = stream->consumed + i + 1;\n"
+     << "  }\n"
+     << "  stream->state = s;\n"
+     << "  stream->consumed += i;\n"
+     << "  stream->longestMatch = longestMatch;\n"
+     << "  return s != 0;\n"
+     << "}\n";
+  ss << "int " << name << "_feedv(struct " << name
+     << "_stream* stream, const struct iovec* iov, int iovcnt) {\n"
+     << "  for(int i = 0; i < iovcnt && stream->state != 0; i++)\n"
+     << "    " << name
+     << "_feed(stream, (const char*)iov[i].iov_base, (long)iov[i].iov_len);\n"
+     << "  return stream->state != 0;\n"
+     << "}";
+  return ss.str();
+}
+
+std::string DenseDFA::toBatchC(const std::string& name) const {
+  // the same loop as runBatch
+  std::string lanes = std::to_string(BatchLanes);
+  std::string step = name + "_table[s + " + name + "_classes[c]]";
+  std::stringstream ss;
+  ss << "void " << name
+     << "_matchBatch(const char* const* inputs, const long* lengths, long n, "
+        "long* results) {\n"
+     << "  const char* begin[" << lanes << "];\n"
+     << "  long length[" << lanes << "], counter[" << lanes
+     << "], longestMatch[" << lanes << "], index[" << lanes << "];\n"
+     << "  unsigned state[" << lanes << "];\n"
+     << "  long next = 0, busy = 0;\n"
+     << "  for(; busy < " << lanes << " && next < n; busy++, next++) {\n"
+     << "    begin[busy] = inputs[next];\n"
+     << "    length[busy] = lengths[next];\n"
+     << "    counter[busy] = 0;\n"
+     << "    state[busy] = " << start_ << ";\n"
+     << "    longestMatch[busy] = " << (isAccept(start_) ? 0 : -1) << ";\n"
+     << "    index[busy] = next;\n"
+     << "  }\n"
+     << "  while(busy == " << lanes << ") {\n"
+     << "    long steps = " << BatchBlock << ";\n"
+     << "    for(int l = 0; l < " << lanes << "; l++)\n"
+     << "      if(length[l] - counter[l] < steps) steps = length[l] - "
+        "counter[l];\n"
+     << "    for(long i = 0; i < steps; i++) {\n"
+     << "      for(int l = 0; l < " << lanes << "; l++) {\n"
+     << "        unsigned char c = begin[l][counter[l] + i];\n"
+     << "        unsigned s = state[l];\n"
+     << "        s = " << step << ";\n"
+     << "        state[l] = s;\n"
+     << "        longestMatch[l] = " << isAcceptC(name, "s")
+     << " ? counter[l] + i + 1 : longestMatch[l];\n"
+     << "      }\n"
+     << "    }\n"
+     << "    for(int l = 0; l < " << lanes << "; l++) counter[l] += steps;\n"
+     << "    for(int l = 0; l < busy;) {\n"
+     << "      if(counter[l] < length[l] && state[l] != 0) {\n"
+     << "        l++;\n"
+     << "        continue;\n"
+     << "      }\n"
+     << "      results[index[l]] = longestMatch[l];\n"
+     << "      if(next < n) {\n"
+     << "        begin[l] = inputs[next];\n"
+     << "        length[l] = lengths[next];\n"
+     << "        counter[l] = 0;\n"
+     << "        state[l] = " << start_ << ";\n"
+     << "        longestMatch[l] = " << (isAccept(start_) ? 0 : -1) << ";\n"
+     << "        index[l] = next++;\n"
+     << "        l++;\n"
+     << "        continue;\n"
+     << "      }\n"
+     << "      busy--;\n"
+     << "      begin[l] = begin[busy];\n"
+     << "      length[l] = length[busy];\n"
+     << "      counter[l] = counter[busy];\n"
+     << "      longestMatch[l] = longestMatch[busy];\n"
+     << "      state[l] = state[busy];\n"
+     << "      index[l] = index[busy];\n"
+     << "    }\n"
+     << "  }\n"
+     << "  for(int l = 0; l < busy; l++) {\n"
+     << "    unsigned s = state[l];\n"
+     << "    for(long i = counter[l]; s != 0 && i < length[l]; i++) {\n"
+     << "      unsigned char c = begin[l][i];\n"
+     << "      s = " << step << ";\n"
+     << "      if(" << isAcceptC(name, "s") << ") longestMatch[l] = i + 1;\n"
+     << "    }\n"
+     << "    results[index[l]] = longestMatch[l];\n"
+     << "  }\n"
+     << "}";
+  return ss.str();
+}
@@ -0,0 +1,177 @@
+#ifndef OPAL_STATE_DENSEDFA_H_
+#define OPAL_STATE_DENSEDFA_H_
+
+#include "Automaton.h"
+#include "ByteClasses.h"
+#include "ByteScanner.h"
+#include "Prefilter.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+class StateList;
+struct iovec;
+
+// runs a DFA in process from a flat transition table, no code generation or
+// toolchain needed
+// the table has one row per state and one column per byte class, rows are
+// padded to a power of two so entries can hold the premultiplied offset of the
+// next row. row 0 is the dead state, every entry in it is 0
+// input without the required literals is rejected before the table is
+// touched, and a required prefix is skipped over once it has been compared
+class DenseDFA {
+public:
+  using StateId = uint32_t;
+  static constexpr StateId Dead = 0;
+
+  // [start, end) of a match in the input, both -1 when there isn't one
+  struct Match {
+    long start = -1;
+    long end = -1;
+    bool found() const { return start >= 0; }
+  };
+
+  // where matching is in input that arrives in pieces, see feed
+  struct Stream {
+    StateId state = Dead;
+    // bytes fed so far
+    long consumed = 0;
+    // the longest match so far, measured from the start of the stream
+    long longestMatch = -1;
+    // no more input can change `longestMatch`
+    bool done() const { return state == Dead; }
+  };
+
+private:
+  ByteClasses classes_;
+  size_t strideShift_ = 0;
+  size_t nStates_ = 0;
+  StateId start_ = Dead;
+  std::vector<uint32_t> table_;
+  // indexed by row, not by offset
+  std::vector<uint64_t> accepts_;
+  Prefilter prefilter_;
+  // where matching resumes once the prefix has been compared
+  StateId afterPrefix_ = Dead;
+  long prefixLength_ = 0;
+  // bytes with an edge out of the start state, a match can only start at one
+  ByteScanner startBytes_;
+
+public:
+  // `dfa` must be a DFA, see Automaton::isDFA
+  explicit DenseDFA(const Automaton& dfa);
+  explicit DenseDFA(const StateList& dfa)
+      : DenseDFA(Automaton::fromStateList(dfa)) {}
+
+  // same contract as the generated matchers, the length of the longest prefix
+  // of input that matches or -1
+  long match(const char* input, long length) const {
+    if(!prefilter_.empty() && !prefilter_.mayMatch(input, length)) return -1;
+    return run(input, length, afterPrefix_, prefixLength_);
+  }
+  long operator()(const char* input, long length) const {
+    return match(input, length);
+  }
+
+  // the leftmost match anywhere in input, and the longest one starting there
+  // offsets are skipped with a simd scan for the bytes that can start a match
+  // and the table only runs from the ones it finds
+  Match search(const char* input, long length) const;
+
+  // where the first match to end ends, or -1. for DFAs of
+  // Automaton::unanchored, which have a match ending wherever any match ends
+  long earliestMatch(const char* input, long length) const;
+  // the smallest position p where input[p, length) matches, or -1, reading
+  // input backwards from its end. for DFAs of Automaton::reversed
+  long reverseMatch(const char* input, long length) const;
+
+  // an empty stream, feed it the input and read `longestMatch` at any point
+  // the prefilter is skipped since it needs the whole input
+  Stream startStream() const {
+    Stream stream;
+    stream.state = start_;
+    stream.longestMatch = isAccept(start_) ? 0 : -1;
+    return stream;
+  }
+  // runs the next piece of input from where `stream` stopped, without
+  // copying it. returns false once the stream is done
+  bool feed(Stream& stream, const char* input, long length) const;
+  bool feed(Stream& stream, const struct iovec* iov, int iovcnt) const;
+
+  // the longest match starting at each input, same as calling match on each
+  // up to `BatchLanes` inputs run in lockstep, one byte of each per turn, so
+  // the table loads of different inputs overlap instead of each one waiting
+  // on the load before it
+  static constexpr size_t BatchLanes = 8;
+  // lanes step at most this many bytes between checks, so one that dies
+  // early is replaced soon instead of stepping the dead row to the end of
+  // the shortest input
+  static constexpr long BatchBlock = 8;
+  void matchBatch(
+      const char* const* inputs,
+      const long* lengths,
+      size_t n,
+      long* results) const;
+  // input i is data[offsets[i], offsets[i + 1]), there are n + 1 offsets
+  void matchBatch(
+      const char* data,
+      const long* offsets,
+      size_t n,
+      long* results) const;
+
+  // C for the table, the matchers below use it
+  std::string toTablesC(const std::string& name) const;
+  // C for a streaming matcher, for input the generated matchers can't take in
+  // one buffer:
+  //   struct <name>_stream { unsigned state; long consumed, longestMatch; };
+  //   void <name>_start(struct <name>_stream*);
+  //   int <name>_feed(struct <name>_stream*, const char*, long);
+  //   int <name>_feedv(struct <name>_stream*, const struct iovec*, int);
+  // the feeds return 0 once the stream is done. needs <sys/uio.h>
+  std::string toStreamC(const std::string& name) const;
+  // C for matchBatch without the prefilter:
+  //   void <name>_matchBatch(const char* const*, const long*, long, long*);
+  std::string toBatchC(const std::string& name) const;
+
+  // states are table offsets, as stored in the table
+  StateId start() const { return start_; }
+  StateId next(StateId s, unsigned char c) const {
+    return table_[s + classes_.classOf(c)];
+  }
+  bool isAccept(StateId s) const {
+    size_t row = s >> strideShift_;
+    return (accepts_[row / 64] >> (row % 64)) & 1;
+  }
+
+  // includes the dead state
+  size_t size() const { return nStates_; }
+  size_t stride() const { return size_t(1) << strideShift_; }
+  const ByteClasses& classes() const { return classes_; }
+  size_t tableBytes() const { return table_.size() * sizeof(uint32_t); }
+  const Prefilter& prefilter() const { return prefilter_; }
+  const ByteScanner& startBytes() const { return startBytes_; }
+
+private:
+  // `input(i, begin, length)` fetches input i
+  template <class Input>
+  void runBatch(size_t n, Input input, long* results) const;
+  // C for checking whether `s` accepts
+  std::string isAcceptC(const std::string& name, const std::string& s) const;
+
+  // run the table from state `s` with `counter` bytes already consumed
+  long run(const char* input, long length, StateId s, long counter) const {
+    const uint32_t* table = table_.data();
+    const uint8_t* classOf = classes_.map().data();
+    long longestMatch = isAccept(s) ? counter : -1;
+    for(; counter < length; counter++) {
+      s = table[s + classOf[(unsigned char)input[counter]]];
+      if(s == Dead) break;
+      longestMatch = isAccept(s) ? counter + 1 : longestMatch;
+    }
+    return longestMatch;
+  }
+};
+
+#endif
@@ -0,0 +1,98 @@
+#include "LazyDFA.h"
+
+LazyDFA::LazyDFA(Automaton nfa, size_t memoryBudget)
+    : classes_(ByteClasses::fromAutomaton(nfa)),
+      nfa_(classes_.compress(nfa)), closures_(nfa_.epsilonClosures()),
+      startSet_(nfa_.size()), memoryBudget_(memoryBudget) {
+  // an automaton with no states starts on the empty set, which never matches
+  if(nfa_.size() == 0) return;
+  for(auto s : closures_[nfa_.entry()])
+    startSet_.insert(s);
+}
+
+void LazyDFA::flush() {
+  states_.clear();
+  next_.clear();
+  lookup_.clear();
+  start_ = Unknown;
+  memoryUsed_ = 0;
+}
+
+size_t LazyDFA::stateCost() const {
+  // the state, its transitions, its set, and its entry in the lookup table
+  // (which keeps a copy of the set)
+  size_t setBytes = (nfa_.size() + 63) / 64 * sizeof(uint64_t);
+  return sizeof(CachedState) + classes_.size() * sizeof(int32_t) +
+         2 * setBytes + sizeof(StateSet) + sizeof(int32_t) + 2 * sizeof(void*);
+}
+
+int32_t LazyDFA::getOrAddState(StateSet set) {
+  auto it = lookup_.find(set);
+  if(it != lookup_.end()) return it->second;
+
+  // out of room, throw everything away and start over. there is always room
+  // for at least one state so the match can make progress
+  size_t cost = stateCost();
+  if(memoryUsed_ + cost > memoryBudget_ && !states_.empty()) {
+    flush();
+    stats_.flushes++;
+  }
+
+  bool isAccept = false;
+  set.forEach([this, &isAccept](size_t id) {
+    isAccept = isAccept || nfa_.isAccept(Automaton::StateId(id));
+  });
+
+  int32_t id = int32_t(states_.size());
+  states_.push_back({set, isAccept});
+  next_.resize(next_.size() + classes_.size(), Unknown);
+  lookup_.emplace(std::move(set), id);
+  memoryUsed_ += cost;
+  return id;
+}
+
+int32_t LazyDFA::transition(int32_t from, uint8_t cls) {
+  StateSet target(nfa_.size());
+  states_[from].set.forEach([this, cls, &target](size_t nfaState) {
+    for(const auto& e : nfa_.edges(Automaton::StateId(nfaState))) {
+      if(e.label != cls) continue;
+      for(auto s : closures_[e.to])
+        target.insert(s);
+    }
+  });
+
+  size_t idx = from * classes_.size() + cls;
+  if(target.empty()) {
+    next_[idx] = Dead;
+    return Dead;
+  }
+
+  size_t flushes = stats_.flushes;
+  int32_t to = getOrAddState(std::move(target));
+  // if the cache was flushed `from` is gone, the link is rebuilt next time
+  if(flushes == stats_.flushes) next_[idx] = to;
+  return to;
+}
+
+long LazyDFA::match(const char* input, long length) {
+  if(start_ == Unknown) start_ = getOrAddState(startSet_);
+
+  long longestMatch = -1;
+  int32_t curr = start_;
+  for(long counter = 0;; counter++) {
+    if(states_[curr].isAccept) longestMatch = counter;
+    if(counter >= length) break;
+
+    uint8_t cls = classes_.classOf(input[counter]);
+    int32_t next = next_[curr * classes_.size() + cls];
+    if(next == Unknown) {
+      stats_.misses++;
+      next = transition(curr, cls);
+    } else {
+      stats_.hits++;
+    }
+    if(next == Dead) break;
+    curr = next;
+  }
+  return longestMatch;
+}
@@ -0,0 +1,86 @@
+#ifndef OPAL_STATE_LAZYDFA_H_
+#define OPAL_STATE_LAZYDFA_H_
+
+#include "Automaton.h"
+#include "ByteClasses.h"
+#include "StateSet.h"
+
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+class StateList;
+
+// builds DFA states from an NFA as the input reaches them, instead of running
+// the whole subset construction up front
+// states live in a cache that is flushed when it grows past `memoryBudget`
+// bytes, so only the part of the automaton the input uses is paid for
+class LazyDFA {
+public:
+  struct Stats {
+    // transitions found in the cache
+    size_t hits = 0;
+    // transitions that had to be built from the NFA
+    size_t misses = 0;
+    // times the cache hit the memory budget and was cleared
+    size_t flushes = 0;
+  };
+
+private:
+  static constexpr int32_t Unknown = -1;
+  static constexpr int32_t Dead = -2;
+
+  struct CachedState {
+    StateSet set;
+    bool isAccept;
+  };
+
+  // the NFA is stored over byte classes so each cached state only needs one
+  // transition per class
+  ByteClasses classes_;
+  Automaton nfa_;
+  std::vector<std::vector<Automaton::StateId>> closures_;
+  StateSet startSet_;
+  size_t memoryBudget_;
+
+  std::vector<CachedState> states_;
+  // next state for [state * classes + class]
+  std::vector<int32_t> next_;
+  std::unordered_map<StateSet, int32_t, StateSet::Hash> lookup_;
+  int32_t start_ = Unknown;
+  size_t memoryUsed_ = 0;
+  Stats stats_;
+
+public:
+  explicit LazyDFA(Automaton nfa, size_t memoryBudget = 1 << 20);
+  explicit LazyDFA(const StateList& nfa, size_t memoryBudget = 1 << 20)
+      : LazyDFA(Automaton::fromStateList(nfa), memoryBudget) {}
+  ~LazyDFA() = default;
+  LazyDFA(const LazyDFA& other) = delete;
+  LazyDFA(LazyDFA&& other) noexcept = default;
+  LazyDFA& operator=(const LazyDFA& other) = delete;
+  LazyDFA& operator=(LazyDFA&& other) noexcept = default;
+
+  // same contract as the generated matchers, the length of the longest prefix
+  // of input that matches or -1
+  long match(const char* input, long length);
+  long operator()(const char* input, long length) {
+    return match(input, length);
+  }
+
+  const Stats& stats() const { return stats_; }
+  void resetStats() { stats_ = Stats(); }
+  size_t cachedStates() const { return states_.size(); }
+  size_t memoryUsed() const { return memoryUsed_; }
+  size_t memoryBudget() const { return memoryBudget_; }
+
+  // drop every cached state
+  void flush();
+
+private:
+  size_t stateCost() const;
+  int32_t getOrAddState(StateSet set);
+  int32_t transition(int32_t from, uint8_t cls);
+};
+
+#endif
@@ -0,0 +1,265 @@
+#include "Literals.h"
+
+#include "Automaton.h"
+#include "DFA.h"
+
+#include <algorithm>
+#include <cassert>
+
+/*
+required literals of a DFA
+
+only useful states count, ones that are reachable from the entry and can reach
+an accept
+
+prefix  walk forward from the entry while the state has exactly one edge and
+        is not an accept
+suffix  walk backward from the accepts while every edge entering the current
+        set has the same label and the set does not hold the entry
+inner   the dominators of a virtual sink that every accept leads to, with each
+        edge split into its own node. every edge on that chain is taken by
+        every match, in order. two chain edges form one literal when the state
+        between them has only the one edge leaving it
+longest the longest path from the entry to an accept, there is none when a
+        useful state is on a cycle
+
+the dominators are found with the iterative algorithm of Cooper, Harvey and
+Kennedy, which is fast enough for the size of DFAs we build. equivalent states
+hide dominators from each other, so the DFA should be minimized first
+*/
+
+std::string RequiredLiterals::toString() const {
+  if(empty()) return "no usable literal";
+  std::string ret;
+  std::string sep;
+  if(!prefix.empty()) {
+    ret += "prefix '" + prefix + "'";
+    sep = ", ";
+  }
+  if(!suffix.empty()) {
+    ret += sep + "suffix '" + suffix + "'";
+    sep = ", ";
+  }
+  if(!inner.empty()) ret += sep + "inner '" + inner + "'";
+  return ret;
+}
+
+RequiredLiterals Automaton::requiredLiterals() const {
+  assert(isDFA());
+  RequiredLiterals literals;
+  const size_t n = size();
+
+  // useful states, forward then backward reachability
+  std::vector<bool> reachable(n, false);
+  std::vector<StateId> toExplore = {entry()};
+  while(!toExplore.empty()) {
+    auto s = toExplore.back();
+    toExplore.pop_back();
+    if(reachable[s]) continue;
+    reachable[s] = true;
+    for(const auto& e : edges(s))
+      toExplore.push_back(e.to);
+  }
+  std::vector<std::vector<std::pair<StateId, Label>>> predecessors(n);
+  for(StateId s = 0; s < n; s++) {
+    if(!reachable[s]) continue;
+    for(const auto& e : edges(s))
+      predecessors[e.to].push_back({s, e.label});
+  }
+  std::vector<bool> useful(n, false);
+  for(StateId s = 0; s < n; s++) {
+    if(reachable[s] && isAccept(s)) toExplore.push_back(s);
+  }
+  while(!toExplore.empty()) {
+    auto s = toExplore.back();
+    toExplore.pop_back();
+    if(useful[s]) continue;
+    useful[s] = true;
+    for(auto [p, label] : predecessors[s])
+      toExplore.push_back(p);
+  }
+  if(!useful[entry()]) return literals;
+
+  // longest, a depth first walk that gives up on reaching a state still on
+  // the stack
+  constexpr long Unvisited = -2;
+  constexpr long OnStack = -3;
+  std::vector<long> longest(n, Unvisited);
+  std::vector<std::pair<StateId, size_t>> walk = {{entry(), 0}};
+  longest[entry()] = OnStack;
+  bool bounded = true;
+  while(bounded && !walk.empty()) {
+    auto [s, next] = walk.back();
+    auto out = edges(s);
+    if(next < out.size()) {
+      walk.back().second++;
+      auto to = out.begin()[next].to;
+      if(!useful[to]) continue;
+      if(longest[to] == OnStack) bounded = false;
+      if(longest[to] != Unvisited) continue;
+      longest[to] = OnStack;
+      walk.push_back({to, 0});
+      continue;
+    }
+    long best = isAccept(s) ? 0 : -1;
+    for(const auto& e : out) {
+      if(useful[e.to]) best = std::max(best, longest[e.to] + 1);
+    }
+    longest[s] = best;
+    walk.pop_back();
+  }
+  if(bounded) literals.maxLength = longest[entry()];
+
+  auto usefulEdges = [&](StateId s) {
+    std::vector<Edge> out;
+    for(const auto& e : edges(s)) {
+      if(useful[e.to]) out.push_back(e);
+    }
+    return out;
+  };
+
+  // prefix, bounded by n so a cycle of single edges can't loop forever
+  StateId s = entry();
+  while(!isAccept(s) && literals.prefix.size() < n) {
+    auto out = usefulEdges(s);
+    if(out.size() != 1) break;
+    literals.prefix += char(out[0].label);
+    s = out[0].to;
+  }
+
+  // suffix
+  std::vector<StateId> set;
+  for(StateId s = 0; s < n; s++) {
+    if(useful[s] && isAccept(s)) set.push_back(s);
+  }
+  while(literals.suffix.size() < n) {
+    if(std::find(set.begin(), set.end(), entry()) != set.end()) break;
+    std::vector<StateId> from;
+    bool same = true;
+    Label label = Epsilon;
+    for(auto t : set) {
+      for(auto [p, l] : predecessors[t]) {
+        if(!useful[p]) continue;
+        if(label == Epsilon) label = l;
+        same = same && l == label;
+        from.push_back(p);
+      }
+    }
+    if(!same || from.empty()) break;
+    literals.suffix += char(label);
+    std::sort(from.begin(), from.end());
+    from.erase(std::unique(from.begin(), from.end()), from.end());
+    set = std::move(from);
+  }
+  std::reverse(literals.suffix.begin(), literals.suffix.end());
+
+  // inner, on a graph of states [0, n), then edges, then the sink
+  struct SplitEdge {
+    StateId from;
+    StateId to;
+    Label label;
+  };
+  std::vector<SplitEdge> split;
+  for(StateId s = 0; s < n; s++) {
+    if(!useful[s]) continue;
+    for(const auto& e : usefulEdges(s))
+      split.push_back({s, e.to, e.label});
+  }
+  const size_t sink = n + split.size();
+  const size_t nNodes = sink + 1;
+  std::vector<std::vector<size_t>> succ(nNodes);
+  std::vector<std::vector<size_t>> pred(nNodes);
+  auto link = [&](size_t from, size_t to) {
+    succ[from].push_back(to);
+    pred[to].push_back(from);
+  };
+  for(size_t i = 0; i < split.size(); i++) {
+    link(split[i].from, n + i);
+    link(n + i, split[i].to);
+  }
+  for(StateId s = 0; s < n; s++) {
+    if(useful[s] && isAccept(s)) link(s, sink);
+  }
+
+  // reverse postorder from the entry
+  constexpr size_t Undefined = size_t(-1);
+  std::vector<size_t> order;
+  std::vector<size_t> rpo(nNodes, Undefined);
+  {
+    std::vector<bool> seen(nNodes, false);
+    std::vector<std::pair<size_t, size_t>> stack = {{entry(), 0}};
+    seen[entry()] = true;
+    while(!stack.empty()) {
+      auto& [node, next] = stack.back();
+      if(next < succ[node].size()) {
+        auto to = succ[node][next++];
+        if(!seen[to]) {
+          seen[to] = true;
+          stack.push_back({to, 0});
+        }
+      } else {
+        order.push_back(node);
+        stack.pop_back();
+      }
+    }
+    std::reverse(order.begin(), order.end());
+    for(size_t i = 0; i < order.size(); i++)
+      rpo[order[i]] = i;
+  }
+
+  std::vector<size_t> idom(nNodes, Undefined);
+  idom[entry()] = entry();
+  auto intersect = [&](size_t a, size_t b) {
+    while(a != b) {
+      while(rpo[a] > rpo[b])
+        a = idom[a];
+      while(rpo[b] > rpo[a])
+        b = idom[b];
+    }
+    return a;
+  };
+  bool changed = true;
+  while(changed) {
+    changed = false;
+    for(auto node : order) {
+      if(node == entry()) continue;
+      size_t newIdom = Undefined;
+      for(auto p : pred[node]) {
+        if(idom[p] == Undefined) continue;
+        newIdom = newIdom == Undefined ? p : intersect(p, newIdom);
+      }
+      if(newIdom != idom[node]) {
+        idom[node] = newIdom;
+        changed = true;
+      }
+    }
+  }
+
+  // the chain of dominators of the sink, entry first
+  std::vector<size_t> chain;
+  for(size_t node = idom[sink]; node != entry(); node = idom[node])
+    chain.push_back(node);
+  std::reverse(chain.begin(), chain.end());
+
+  std::string current;
+  const SplitEdge* last = nullptr;
+  for(auto node : chain) {
+    if(node < n || node == sink) continue;
+    const auto& e = split[node - n];
+    bool continues =
+        last && last->to == e.from && usefulEdges(e.from).size() == 1;
+    if(!continues) current.clear();
+    current += char(e.label);
+    if(current.size() > literals.inner.size()) literals.inner = current;
+    last = &e;
+  }
+
+  return literals;
+}
+
+RequiredLiterals StateList::requiredLiterals() const {
+  auto a = Automaton::fromStateList(*this);
+  if(a.isDFA()) return a.requiredLiterals();
+  // equivalent states split the dominator chain, so minimize first
+  return a.buildDFA().prune().minimize().requiredLiterals();
+}
@@ -0,0 +1,25 @@
+#ifndef OPAL_STATE_LITERALS_H_
+#define OPAL_STATE_LITERALS_H_
+
+#include <string>
+
+// substrings every match of a pattern must contain
+// all three are empty when the pattern has no usable literal, for example
+// when it matches the empty string or starts with a choice
+struct RequiredLiterals {
+  // every match starts with this
+  std::string prefix;
+  // every match ends with this
+  std::string suffix;
+  // the longest run of bytes that every match contains somewhere
+  std::string inner;
+  // the length of the longest match, -1 when matches can be any length
+  long maxLength = -1;
+
+  bool empty() const {
+    return prefix.empty() && suffix.empty() && inner.empty();
+  }
+  std::string toString() const;
+};
+
+#endif
@@ -0,0 +1,207 @@
+#include "Automaton.h"
+#include "DFA.h"
+
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <map>
+
+/*
+Hopcroft's partition refinement
+
+states start partitioned into non-accepts and accepts, with accepts that match
+different patterns kept apart. a (block, label) pair on the worklist is a
+splitter: every block is split into the states that reach the splitter on that
+label and the states that do not. when a block in the worklist is split both
+halves are queued, otherwise only the smaller half is
+
+the partition is one array of states with each block a range of it. marking a
+state swaps it to the front of its block, so splitting costs the number of
+marked states and not the size of the block. with the smaller half rule that
+gives O(n k log n)
+
+the DFA is partial, missing transitions go to an implicit dead state which is
+given the last index and loops to itself on every label
+*/
+Automaton Automaton::minimize() const {
+  assert(isDFA());
+
+  const size_t nStates = size();
+  const size_t dead = nStates;
+  const size_t n = nStates + 1;
+
+  // dense numbering of the labels used, in byte order
+  std::array<bool, 256> used = {};
+  for(StateId s = 0; s < nStates; s++) {
+    for(const auto& e : edges(s))
+      used[e.label] = true;
+  }
+  std::array<size_t, 256> labelOf = {};
+  std::vector<Label> labels;
+  for(Label c = 0; c < 256; c++) {
+    if(!used[c]) continue;
+    labelOf[c] = labels.size();
+    labels.push_back(c);
+  }
+  const size_t k = labels.size();
+
+  // delta[state * k + label], and the inverse of it, the states reaching
+  // `to` on `a` are inverse[inverseStart[to * k + a], inverseStart[... + 1])
+  std::vector<size_t> delta(n * k, dead);
+  for(StateId s = 0; s < nStates; s++) {
+    for(const auto& e : edges(s))
+      delta[s * k + labelOf[e.label]] = e.to;
+  }
+  std::vector<size_t> inverseStart(n * k + 1, 0);
+  for(size_t i = 0; i < n * k; i++)
+    inverseStart[delta[i] * k + i % k + 1]++;
+  for(size_t i = 0; i < n * k; i++)
+    inverseStart[i + 1] += inverseStart[i];
+  std::vector<size_t> inverse(n * k);
+  {
+    std::vector<size_t> fill(inverseStart.begin(), inverseStart.end() - 1);
+    for(size_t i = 0; i < n * k; i++)
+      inverse[fill[delta[i] * k + i % k]++] = i / k;
+  }
+
+  // initial partition, non-accepts (and the dead state) in one block and
+  // accepts grouped by the patterns they match
+  std::vector<size_t> blockOf(n);
+  std::map<std::pair<bool, std::vector<PatternId>>, size_t> initialBlocks;
+  std::vector<size_t> initialSizes;
+  for(size_t i = 0; i < n; i++) {
+    bool accept = i != dead && isAccept(StateId(i));
+    std::pair<bool, std::vector<PatternId>> key = {accept, {}};
+    if(accept) key.second = patterns(StateId(i));
+    auto [it, inserted] = initialBlocks.emplace(key, initialSizes.size());
+    if(inserted) initialSizes.push_back(0);
+    blockOf[i] = it->second;
+    initialSizes[blockOf[i]]++;
+  }
+
+  // block b is elements[first[b], last[b]), its marked states are the ones
+  // before markedEnd[b]. position[s] is where s is in elements
+  std::vector<size_t> elements(n);
+  std::vector<size_t> position(n);
+  std::vector<size_t> first;
+  std::vector<size_t> last;
+  for(auto size : initialSizes) {
+    first.push_back(last.empty() ? 0 : last.back());
+    last.push_back(first.back() + size);
+  }
+  std::vector<size_t> markedEnd = first;
+  for(size_t i = 0; i < n; i++) {
+    position[i] = markedEnd[blockOf[i]]++;
+    elements[position[i]] = i;
+  }
+  markedEnd = first;
+  auto blockSize = [&first, &last](size_t b) { return last[b] - first[b]; };
+
+  std::vector<std::pair<size_t, size_t>> worklist;
+  // inWorklist[block * k + label]
+  std::vector<bool> inWorklist;
+  auto addSplitter = [&worklist, &inWorklist, k](size_t block, size_t label) {
+    if(inWorklist.size() < (block + 1) * k) inWorklist.resize((block + 1) * k);
+    if(inWorklist[block * k + label]) return;
+    inWorklist[block * k + label] = true;
+    worklist.push_back({block, label});
+  };
+  // every block but the largest is enough to split on
+  size_t largest = 0;
+  for(size_t b = 1; b < first.size(); b++) {
+    if(blockSize(b) > blockSize(largest)) largest = b;
+  }
+  for(size_t b = 0; b < first.size(); b++) {
+    if(b == largest) continue;
+    for(size_t a = 0; a < k; a++)
+      addSplitter(b, a);
+  }
+
+  // scratch space for each split, reset after every use
+  std::vector<size_t> splitterStates;
+  std::vector<size_t> touched;
+
+  while(!worklist.empty()) {
+    auto [splitter, a] = worklist.back();
+    worklist.pop_back();
+    inWorklist[splitter * k + a] = false;
+
+    // marking reorders blocks, the splitter's states are copied out first
+    splitterStates.assign(
+        elements.begin() + long(first[splitter]),
+        elements.begin() + long(last[splitter]));
+
+    // mark every state that reaches the splitter on `a`
+    for(auto to : splitterStates) {
+      size_t i = to * k + a;
+      for(size_t j = inverseStart[i]; j < inverseStart[i + 1]; j++) {
+        size_t from = inverse[j];
+        size_t b = blockOf[from];
+        size_t p = position[from];
+        if(p < markedEnd[b]) continue;
+        if(markedEnd[b] == first[b]) touched.push_back(b);
+        size_t other = elements[markedEnd[b]];
+        std::swap(elements[p], elements[markedEnd[b]]);
+        position[other] = p;
+        position[from] = markedEnd[b]++;
+      }
+    }
+
+    for(auto b : touched) {
+      if(markedEnd[b] != last[b]) {
+        // the marked states at the front of b become a new block
+        size_t newBlock = first.size();
+        first.push_back(first[b]);
+        last.push_back(markedEnd[b]);
+        markedEnd.push_back(first[b]);
+        for(size_t p = first[b]; p < markedEnd[b]; p++)
+          blockOf[elements[p]] = newBlock;
+        first[b] = markedEnd[b];
+
+        size_t smaller = blockSize(b) <= blockSize(newBlock) ? b : newBlock;
+        for(size_t c = 0; c < k; c++) {
+          bool queued = b * k + c < inWorklist.size() && inWorklist[b * k + c];
+          addSplitter(queued ? newBlock : smaller, c);
+        }
+      }
+      markedEnd[b] = first[b];
+    }
+    touched.clear();
+  }
+
+  // rebuild with one state per block, in the order the blocks are first seen
+  // the dead state's block is dropped along with all transitions into it
+  constexpr StateId Unmapped = StateId(-1);
+  const size_t deadBlock = blockOf[dead];
+  const size_t entryBlock = blockOf[entry()];
+  Builder b;
+  std::vector<StateId> blockToState(first.size(), Unmapped);
+  std::vector<StateId> representatives;
+  for(StateId s = 0; s < nStates; s++) {
+    auto block = blockOf[s];
+    if(blockToState[block] != Unmapped) continue;
+    if(block == deadBlock && block != entryBlock) continue;
+    blockToState[block] = b.addState(isAccept(s), std::string(name(s)));
+    b.addPatterns(blockToState[block], patterns(s));
+    representatives.push_back(s);
+  }
+  // every state in a block is equivalent, so the edges of the first one seen
+  // stand for the whole block
+  for(auto s : representatives) {
+    auto from = blockToState[blockOf[s]];
+    for(size_t a = 0; a < k; a++) {
+      auto to = blockOf[delta[s * k + a]];
+      if(to != deadBlock) b.addEdge(from, blockToState[to], labels[a]);
+    }
+  }
+  b.setEntry(blockToState[entryBlock]);
+  return b.build();
+}
+
+StateList::MinimizeStats StateList::minimize() {
+  assert(this->isDFA());
+  MinimizeStats stats = {this->states().size(), 0};
+  *this = Automaton::fromStateList(*this).minimize().toStateList();
+  stats.statesAfter = this->states().size();
+  return stats;
+}
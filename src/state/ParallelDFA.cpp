@@ -0,0 +1,166 @@
+#include "ParallelDFA.h"
+
+#include "DFA.h"
+#include "common/ThreadPool.h"
+
+#include <algorithm>
+#include <future>
+
+ParallelDFA::ParallelDFA(
+    const DenseDFA& dfa,
+    common::ThreadPool& pool,
+    size_t nChunks)
+    : dfa_(dfa), pool_(pool), nChunks_(nChunks ? nChunks : pool.size()) {
+  if(ShuffleDFA::fits(dfa)) shuffle_.emplace(dfa);
+}
+
+std::vector<ParallelDFA::ChunkResult> ParallelDFA::runChunk(
+    const char* input,
+    long length,
+    const std::vector<DenseDFA::StateId>& from) const {
+  using StateId = DenseDFA::StateId;
+  size_t stride = dfa_.stride();
+  if(shuffle_) {
+    // every row is run, whatever `from` holds
+    auto map = shuffle_->run(input, length);
+    std::vector<ChunkResult> results(dfa_.size());
+    for(size_t row = 1; row < results.size(); row++)
+      results[row] = {StateId(map.end[row] * stride), map.lastAccept[row]};
+    return results;
+  }
+
+  // until a run's origins merge with another run the results hold the last
+  // accept from before the merge
+  std::vector<ChunkResult> results(dfa_.size());
+
+  // one run for every group of origins that have reached the same state
+  struct Run {
+    StateId state;
+    long lastAccept;
+    std::vector<StateId> origins;
+  };
+  std::vector<Run> runs;
+  std::vector<int32_t> runOf(dfa_.size(), -1);
+  for(auto s : from) {
+    if(s == DenseDFA::Dead) continue;
+    auto& slot = runOf[s / stride];
+    if(slot < 0) {
+      slot = int32_t(runs.size());
+      runs.push_back({s, -1, {}});
+    }
+    runs[slot].origins.push_back(StateId(s / stride));
+  }
+  for(auto& slot : runOf)
+    slot = -1;
+
+  // runs are stepped a block at a time, then the ones in the same state are
+  // merged and the dead ones dropped
+  const long block = 64;
+  for(long pos = 0; pos < length && !runs.empty(); pos += block) {
+    long stop = std::min(length, pos + block);
+    for(auto& run : runs) {
+      StateId s = run.state;
+      long lastAccept = run.lastAccept;
+      for(long i = pos; i < stop; i++) {
+        s = dfa_.next(s, (unsigned char)input[i]);
+        if(s == DenseDFA::Dead) break;
+        lastAccept = dfa_.isAccept(s) ? i + 1 : lastAccept;
+      }
+      run.state = s;
+      run.lastAccept = lastAccept;
+    }
+
+    size_t kept = 0;
+    for(size_t r = 0; r < runs.size(); r++) {
+      auto& run = runs[r];
+      if(run.state == DenseDFA::Dead) {
+        for(auto o : run.origins) {
+          if(run.lastAccept >= 0) results[o].lastAccept = run.lastAccept;
+        }
+        continue;
+      }
+      auto& slot = runOf[run.state / stride];
+      if(slot < 0) {
+        slot = int32_t(kept);
+        if(kept != r) runs[kept] = std::move(run);
+        kept++;
+        continue;
+      }
+      // the runs share everything from here on, but not their accepts so far
+      auto& keeper = runs[slot];
+      if(keeper.lastAccept != run.lastAccept) {
+        for(auto o : keeper.origins) {
+          if(keeper.lastAccept >= 0) results[o].lastAccept = keeper.lastAccept;
+        }
+        keeper.lastAccept = -1;
+      }
+      for(auto o : run.origins) {
+        if(run.lastAccept >= 0) results[o].lastAccept = run.lastAccept;
+      }
+      keeper.origins.insert(
+          keeper.origins.end(),
+          run.origins.begin(),
+          run.origins.end());
+    }
+    runs.resize(kept);
+    for(const auto& run : runs)
+      runOf[run.state / stride] = -1;
+  }
+
+  for(const auto& run : runs) {
+    for(auto o : run.origins) {
+      results[o].end = run.state;
+      if(run.lastAccept >= 0) results[o].lastAccept = run.lastAccept;
+    }
+  }
+  return results;
+}
+
+long ParallelDFA::match(const char* input, long length) const {
+  size_t nChunks = std::max<size_t>(1, std::min<size_t>(nChunks_, length));
+  long chunkLength = length / long(nChunks);
+
+  std::vector<DenseDFA::StateId> all;
+  for(size_t row = 1; row < dfa_.size(); row++)
+    all.push_back(DenseDFA::StateId(row * dfa_.stride()));
+  std::vector<DenseDFA::StateId> start = {dfa_.start()};
+
+  std::vector<std::future<std::vector<ChunkResult>>> chunks;
+  for(size_t k = 0; k < nChunks; k++) {
+    long begin = long(k) * chunkLength;
+    long end = k + 1 == nChunks ? length : begin + chunkLength;
+    const auto& from = k == 0 ? start : all;
+    chunks.push_back(pool_.submit([this, input, begin, end, &from]() {
+      return runChunk(input + begin, end - begin, from);
+    }));
+  }
+
+  // chain the chunks from the start state
+  DenseDFA::StateId s = dfa_.start();
+  long longestMatch = dfa_.isAccept(s) ? 0 : -1;
+  for(size_t k = 0; k < nChunks; k++) {
+    auto results = chunks[k].get();
+    if(s == DenseDFA::Dead) continue;
+    const auto& result = results[s / dfa_.stride()];
+    if(result.lastAccept >= 0)
+      longestMatch = long(k) * chunkLength + result.lastAccept;
+    s = result.end;
+  }
+  return longestMatch;
+}
+
+bool ParallelDFA::worthwhile(size_t dfaStates, long length, size_t threads) {
+  // every state runs for at least the first block of a chunk, keep that a
+  // small part of the chunk, and keep chunks big enough to outweigh handing
+  // them to threads
+  if(threads < 2) return false;
+  long chunkLength = length / long(threads);
+  return chunkLength >= (1 << 20) && long(dfaStates) * 4096 <= chunkLength;
+}
+
+bool ParallelDFA::worthwhile(
+    const StateList& dfa,
+    long length,
+    size_t threads) {
+  return worthwhile(dfa.states().size(), length, threads);
+}
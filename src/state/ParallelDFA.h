@@ -0,0 +1,64 @@
+#ifndef OPAL_STATE_PARALLELDFA_H_
+#define OPAL_STATE_PARALLELDFA_H_
+
+#include "DenseDFA.h"
+#include "ShuffleDFA.h"
+
+#include <cstddef>
+#include <optional>
+#include <vector>
+
+class StateList;
+namespace common {
+class ThreadPool;
+}
+
+// matches one long input on several threads by splitting it into chunks
+// the first chunk runs from the start state as usual. every other chunk can't
+// know its starting state until the chunks before it are done, so it runs from
+// every DFA state at once and records where each one ends up and its last
+// accept. the maps are then chained from the start state
+// runs from different states usually reach the same state within a few bytes,
+// they are merged as they do, so a chunk costs a small multiple of a
+// sequential run instead of one run per state. DFAs that fit in a ShuffleDFA
+// run every state in one vector instead, for about the cost of one run
+class ParallelDFA {
+public:
+  // what running a chunk from a state did
+  struct ChunkResult {
+    DenseDFA::StateId end = DenseDFA::Dead;
+    // the end of the last accept in the chunk, from the start of the chunk
+    long lastAccept = -1;
+  };
+
+private:
+  const DenseDFA& dfa_;
+  common::ThreadPool& pool_;
+  size_t nChunks_;
+  std::optional<ShuffleDFA> shuffle_;
+
+public:
+  // `nChunks` of 0 is one per pool thread
+  ParallelDFA(
+      const DenseDFA& dfa,
+      common::ThreadPool& pool,
+      size_t nChunks = 0);
+
+  // same contract as DenseDFA::match, without the prefilter
+  long match(const char* input, long length) const;
+
+  // whether splitting should beat one sequential run, each chunk costs about
+  // one sequential run per distinct state the runs haven't merged into yet,
+  // which grows with the number of DFA states
+  static bool worthwhile(size_t dfaStates, long length, size_t threads);
+  static bool worthwhile(const StateList& dfa, long length, size_t threads);
+
+  // indexed by row, the state divided by the stride. only the rows in `from`
+  // are run
+  std::vector<ChunkResult> runChunk(
+      const char* input,
+      long length,
+      const std::vector<DenseDFA::StateId>& from) const;
+};
+
+#endif
@@ -0,0 +1,48 @@
+#include "PikeVM.h"
+
+#include <utility>
+
+PikeVM::PikeVM(Automaton nfa)
+    : nfa_(std::move(nfa)), curr_(nfa_.size()), next_(nfa_.size()) {
+  // every state can be on the stack at most once per edge into it
+  stack_.reserve(nfa_.edgeCount() + 1);
+}
+
+bool PikeVM::addState(SparseSet& list, size_t state) {
+  bool accept = false;
+  stack_.push_back(state);
+  while(!stack_.empty()) {
+    auto s = stack_.back();
+    stack_.pop_back();
+    if(!list.insert(s)) continue;
+    accept = accept || nfa_.isAccept(Automaton::StateId(s));
+    for(const auto& e : nfa_.edges(Automaton::StateId(s))) {
+      if(e.isEpsilon() && !list.contains(e.to)) stack_.push_back(e.to);
+    }
+  }
+  return accept;
+}
+
+long PikeVM::match(const char* input, long length) {
+  long longestMatch = -1;
+  // an automaton with no states has no entry and never matches
+  if(nfa_.size() == 0) return longestMatch;
+
+  curr_.clear();
+  bool accept = addState(curr_, nfa_.entry());
+  for(long counter = 0;; counter++) {
+    if(accept) longestMatch = counter;
+    if(counter >= length || curr_.empty()) break;
+
+    unsigned char c = input[counter];
+    next_.clear();
+    accept = false;
+    for(auto s : curr_) {
+      for(const auto& e : nfa_.edges(Automaton::StateId(s))) {
+        if(e.label == c) accept = addState(next_, e.to) || accept;
+      }
+    }
+    std::swap(curr_, next_);
+  }
+  return longestMatch;
+}
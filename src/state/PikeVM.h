@@ -0,0 +1,76 @@
+#ifndef OPAL_STATE_PIKEVM_H_
+#define OPAL_STATE_PIKEVM_H_
+
+#include "Automaton.h"
+
+#include <cstddef>
+#include <vector>
+
+class StateList;
+
+// a set of integers in [0, capacity) with O(1) insert, lookup and clear
+// (Briggs & Torczon), iteration is in insertion order
+class SparseSet {
+private:
+  std::vector<size_t> dense_;
+  std::vector<size_t> sparse_;
+  size_t size_ = 0;
+
+public:
+  explicit SparseSet(size_t capacity) : dense_(capacity), sparse_(capacity) {}
+
+  bool contains(size_t i) const {
+    return sparse_[i] < size_ && dense_[sparse_[i]] == i;
+  }
+  bool insert(size_t i) {
+    if(contains(i)) return false;
+    dense_[size_] = i;
+    sparse_[i] = size_++;
+    return true;
+  }
+  void clear() { size_ = 0; }
+  bool empty() const { return size_ == 0; }
+  size_t size() const { return size_; }
+
+  const size_t* begin() const { return dense_.data(); }
+  const size_t* end() const { return dense_.data() + size_; }
+};
+
+// simulates an NFA (epsilon transitions allowed) directly, tracking every
+// state the NFA could be in at once
+// each byte of input touches every NFA state and transition at most once, so
+// matching is O(n * m) regardless of how large the equivalent DFA would be
+// a PikeVM is not thread safe
+class PikeVM {
+private:
+  Automaton nfa_;
+
+  // preallocated so matching never allocates
+  SparseSet curr_;
+  SparseSet next_;
+  std::vector<size_t> stack_;
+
+public:
+  explicit PikeVM(Automaton nfa);
+  explicit PikeVM(const StateList& nfa)
+      : PikeVM(Automaton::fromStateList(nfa)) {}
+  ~PikeVM() = default;
+  PikeVM(const PikeVM& other) = delete;
+  PikeVM(PikeVM&& other) noexcept = default;
+  PikeVM& operator=(const PikeVM& other) = delete;
+  PikeVM& operator=(PikeVM&& other) noexcept = default;
+
+  // same contract as the generated matchers, the length of the longest prefix
+  // of input that matches or -1
+  long match(const char* input, long length);
+  long operator()(const char* input, long length) {
+    return match(input, length);
+  }
+
+private:
+  // add `state` and everything reachable from it without consuming to `list`
+  // returns true if any state added was an accept
+  bool addState(SparseSet& list, size_t state);
+};
+
+#endif
@@ -0,0 +1,89 @@
+#include "Prefilter.h"
+
+#include <algorithm>
+#include <cstring>
+#include <sstream>
+
+Prefilter::Prefilter(RequiredLiterals literals)
+    : literals_(std::move(literals)) {
+  // a literal inside one that is already checked adds nothing
+  const auto& prefix = literals_.prefix;
+  const auto& inner = literals_.inner;
+  const auto& suffix = literals_.suffix;
+  if(!inner.empty() && prefix.find(inner) == std::string::npos)
+    searches_.push_back(inner);
+  if(!suffix.empty() && prefix.find(suffix) == std::string::npos &&
+     inner.find(suffix) == std::string::npos)
+    searches_.push_back(suffix);
+  prefixSearch_ = prefix;
+  for(const auto& lit : searches_) {
+    if(lit.find(prefix) != std::string::npos) prefixSearch_.clear();
+  }
+}
+
+static bool contains(const char* input, long length, const std::string& lit) {
+  if(lit.size() == 1) return std::memchr(input, lit[0], size_t(length));
+  return memmem(input, size_t(length), lit.data(), lit.size());
+}
+
+bool Prefilter::mayMatch(const char* input, long length) const {
+  const auto& prefix = literals_.prefix;
+  if(!prefix.empty()) {
+    if(length < long(prefix.size())) return false;
+    if(std::memcmp(input, prefix.data(), prefix.size()) != 0) return false;
+  }
+  if(literals_.maxLength < 0) return true;
+  long limit = std::min(length, literals_.maxLength);
+  for(const auto& lit : searches_) {
+    if(!contains(input, limit, lit)) return false;
+  }
+  return true;
+}
+
+bool Prefilter::mayContainMatch(const char* input, long length) const {
+  if(!prefixSearch_.empty() && !contains(input, length, prefixSearch_))
+    return false;
+  for(const auto& lit : searches_) {
+    if(!contains(input, length, lit)) return false;
+  }
+  return true;
+}
+
+// octal escapes can't run into the next char like hex ones can
+static std::string toCString(const std::string& s) {
+  std::stringstream ss;
+  ss << "\"";
+  for(unsigned char c : s)
+    ss << "\\" << int(c >> 6) << int((c >> 3) & 7) << int(c & 7);
+  ss << "\"";
+  return ss.str();
+}
+
+std::string Prefilter::toC(std::string name) const {
+  std::stringstream ss;
+  ss << "int " << name << "(const char* input, long length) {\n";
+  const auto& prefix = literals_.prefix;
+  if(!prefix.empty()) {
+    ss << "  if(length < " << prefix.size() << " || memcmp(input, "
+       << toCString(prefix) << ", " << prefix.size() << ") != 0) return 0;\n";
+  }
+  if(searches_.empty() || literals_.maxLength < 0) {
+    ss << "  return 1;\n";
+    ss << "}";
+    return ss.str();
+  }
+  ss << "  if(length > " << literals_.maxLength
+     << ") length = " << literals_.maxLength << ";\n";
+  for(const auto& lit : searches_) {
+    if(lit.size() == 1) {
+      ss << "  if(!memchr(input, " << int((unsigned char)lit[0])
+         << ", length)) return 0;\n";
+    } else {
+      ss << "  if(!memmem(input, length, " << toCString(lit) << ", "
+         << lit.size() << ")) return 0;\n";
+    }
+  }
+  ss << "  return 1;\n";
+  ss << "}";
+  return ss.str();
+}
@@ -0,0 +1,42 @@
+#ifndef OPAL_STATE_PREFILTER_H_
+#define OPAL_STATE_PREFILTER_H_
+
+#include "Literals.h"
+
+#include <string>
+#include <vector>
+
+// rejects input that can't hold a match before the automaton runs
+// the prefix is compared in place, the other literals are searched for with
+// memchr or memmem, which libc vectorizes
+// an anchored match only searches as far as the longest match could reach,
+// and not at all when matches can be any length. otherwise a long input would
+// be scanned to its end even when the automaton stops after a few bytes
+class Prefilter {
+private:
+  RequiredLiterals literals_;
+  // literals that still need a search once the prefix has been checked
+  std::vector<std::string> searches_;
+  // the prefix, unless it's inside one of `searches_`
+  std::string prefixSearch_;
+
+public:
+  Prefilter() = default;
+  explicit Prefilter(RequiredLiterals literals);
+
+  // nothing to check, every input may match
+  bool empty() const { return literals_.empty(); }
+  const RequiredLiterals& literals() const { return literals_; }
+
+  // false when `input` can't start with a match
+  bool mayMatch(const char* input, long length) const;
+  // false when there can't be a match anywhere in `input`, every literal is
+  // searched for since the prefix doesn't have to be at the start
+  bool mayContainMatch(const char* input, long length) const;
+
+  // c source for `int <name>(const char* input, long length)` doing the same
+  // checks, for the generated matchers
+  std::string toC(std::string name) const;
+};
+
+#endif
@@ -0,0 +1,16 @@
+#include "Searcher.h"
+
+static Automaton minimalDFA(const Automaton& nfa) {
+  return nfa.buildDFA().prune().minimize();
+}
+
+Searcher::Searcher(const Automaton& nfa)
+    : anchored_(minimalDFA(nfa)), forward_(minimalDFA(nfa.unanchored())),
+      reverse_(minimalDFA(nfa.reversed().unanchored())) {}
+
+DenseDFA::Match Searcher::search(const char* input, long length) const {
+  if(forward_.earliestMatch(input, length) < 0) return {};
+  long start = reverse_.reverseMatch(input, length);
+  // a match starts at `start`, so the longest one from there is found
+  return {start, start + anchored_.match(input + start, length - start)};
+}
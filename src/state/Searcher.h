@@ -0,0 +1,37 @@
+#ifndef OPAL_STATE_SEARCHER_H_
+#define OPAL_STATE_SEARCHER_H_
+
+#include "Automaton.h"
+#include "DenseDFA.h"
+
+class StateList;
+
+// finds the same match as DenseDFA::search, the leftmost one and the longest
+// one starting there, without restarting at every offset
+// a DFA of `.*` and the pattern rejects input without a match, stopping where
+// the first match to end ends. that doesn't bound the leftmost match, which
+// can start before it and end after it. a match starts at p when input[p,
+// length) starts with one, so a DFA of `.*` and the reversed pattern run back
+// from the end of the input accepts at every such p and the last accept is
+// the leftmost start. the anchored DFA finds the longest match from there
+// each input byte is read at most three times
+class Searcher {
+private:
+  DenseDFA anchored_;
+  DenseDFA forward_;
+  DenseDFA reverse_;
+
+public:
+  // the three DFAs are all built from `nfa`, which can be a DFA
+  explicit Searcher(const Automaton& nfa);
+  explicit Searcher(const StateList& nfa)
+      : Searcher(Automaton::fromStateList(nfa)) {}
+
+  DenseDFA::Match search(const char* input, long length) const;
+
+  const DenseDFA& anchored() const { return anchored_; }
+  const DenseDFA& forward() const { return forward_; }
+  const DenseDFA& reverse() const { return reverse_; }
+};
+
+#endif
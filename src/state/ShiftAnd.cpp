@@ -0,0 +1,209 @@
+#include "ShiftAnd.h"
+
+#include "DenseDFA.h"
+
+#include <unordered_map>
+
+ShiftAnd::ShiftAnd(const Automaton& nfa) {
+  auto a = nfa.removeEpsilons();
+
+  // a state for every (state, byte entering it) pair reachable from the
+  // entry, numbered in depth first order so a state's first edge usually
+  // leads to the next number
+  // `origin` is the automaton state each one stands for
+  std::vector<Automaton::StateId> origin;
+  std::unordered_map<uint64_t, uint32_t> idOf;
+  std::vector<std::pair<uint32_t, uint32_t>> edges;
+  auto key = [](Automaton::StateId s, Automaton::Label label) {
+    return (uint64_t(s) << 9) | label;
+  };
+  if(a.size() != 0) {
+    origin.push_back(a.entry());
+    // entry has no byte entering it, 256 isn't a byte
+    idOf[key(a.entry(), Automaton::Epsilon)] = 0;
+    std::vector<uint32_t> toExplore = {0};
+    std::vector<uint32_t> children;
+    while(!toExplore.empty()) {
+      auto id = toExplore.back();
+      toExplore.pop_back();
+      children.clear();
+      for(const auto& e : a.edges(origin[id])) {
+        auto [it, added] = idOf.emplace(key(e.to, e.label), origin.size());
+        if(added) {
+          origin.push_back(e.to);
+          children.push_back(it->second);
+        }
+        edges.emplace_back(id, it->second);
+      }
+      toExplore.insert(toExplore.end(), children.rbegin(), children.rend());
+    }
+  }
+  // renumber so the depth first order decides the bits, ids were handed out
+  // as states were discovered which is breadth first within a state
+  std::vector<uint32_t> bit(origin.size(), UINT32_MAX);
+  {
+    std::vector<std::vector<uint32_t>> out(origin.size());
+    for(const auto& [from, to] : edges)
+      out[from].push_back(to);
+    uint32_t next = 0;
+    std::vector<uint32_t> toExplore;
+    if(!origin.empty()) toExplore.push_back(0);
+    while(!toExplore.empty()) {
+      auto id = toExplore.back();
+      toExplore.pop_back();
+      if(bit[id] != UINT32_MAX) continue;
+      bit[id] = next++;
+      toExplore.insert(toExplore.end(), out[id].rbegin(), out[id].rend());
+    }
+  }
+
+  nStates_ = origin.size();
+  nWords_ = (nStates_ + 63) / 64;
+  auto set = [](std::vector<Word>& v, size_t offset, uint32_t b) {
+    v[offset + b / 64] |= Word(1) << (b % 64);
+  };
+  byteMasks_.assign(256 * nWords_, 0);
+  shiftMask_.assign(nWords_, 0);
+  otherMask_.assign(nWords_, 0);
+  acceptMask_.assign(nWords_, 0);
+  for(const auto& [k, id] : idOf) {
+    if(a.isAccept(origin[id])) set(acceptMask_, 0, bit[id]);
+    if((k & 511) != Automaton::Epsilon)
+      set(byteMasks_, (k & 511) * nWords_, bit[id]);
+  }
+
+  // edges that aren't to the next bit, by the bit they leave
+  std::vector<std::vector<uint32_t>> other(nStates_);
+  for(const auto& [from, to] : edges) {
+    if(bit[to] == bit[from] + 1) set(shiftMask_, 0, bit[to]);
+    else {
+      set(otherMask_, 0, bit[from]);
+      other[bit[from]].push_back(bit[to]);
+    }
+  }
+
+  for(uint32_t chunk = 0; chunk < nWords_ * 8; chunk++) {
+    Word bits = (otherMask_[chunk / 8] >> (chunk % 8 * 8)) & 0xff;
+    if(!bits) continue;
+    size_t slot = chunks_.size();
+    chunks_.push_back(chunk);
+    followTables_.resize((slot + 1) * 256 * nWords_, 0);
+    for(size_t value = 0; value < 256; value++) {
+      if(value & ~bits) continue;
+      size_t offset = (slot * 256 + value) * nWords_;
+      for(uint32_t j = 0; j < 8; j++) {
+        if(!((value >> j) & 1)) continue;
+        for(auto to : other[chunk * 8 + j])
+          set(followTables_, offset, to);
+      }
+    }
+  }
+}
+
+long ShiftAnd::match(const char* input, long length) const {
+  if(nWords_ == 1) return runOneWord<false>(input, length);
+  return run(input, length, false);
+}
+
+long ShiftAnd::earliestMatch(const char* input, long length) const {
+  if(nWords_ == 1) return runOneWord<true>(input, length);
+  return run(input, length, true);
+}
+
+template <bool Unanchored>
+long ShiftAnd::runOneWord(const char* input, long length) const {
+  const Word* byteMasks = byteMasks_.data();
+  const Word* tables = followTables_.data();
+  const uint32_t* chunks = chunks_.data();
+  size_t nChunks = chunks_.size();
+  Word shift = shiftMask_[0];
+  Word other = otherMask_[0];
+  Word accept = acceptMask_[0];
+
+  Word d = 1;
+  long longestMatch = -1;
+  if(d & accept) {
+    if(Unanchored) return 0;
+    longestMatch = 0;
+  }
+  for(long counter = 0; counter < length; counter++) {
+    if(Unanchored) d |= 1;
+    Word n = (d << 1) & shift;
+    if(Word rest = d & other) {
+      for(size_t slot = 0; slot < nChunks; slot++)
+        n |= tables[slot * 256 + ((rest >> (chunks[slot] * 8)) & 0xff)];
+    }
+    d = n & byteMasks[(unsigned char)input[counter]];
+    if(Unanchored) {
+      if(d & accept) return counter + 1;
+    } else {
+      // often taken about half the time, so keep it a conditional move
+      longestMatch = (d & accept) ? counter + 1 : longestMatch;
+      if(!d) break;
+    }
+  }
+  return longestMatch;
+}
+
+long ShiftAnd::run(const char* input, long length, bool unanchored) const {
+  // only allocates when this thread hasn't matched a set this large before
+  thread_local std::vector<Word> curr;
+  thread_local std::vector<Word> next;
+  curr.resize(nWords_);
+  next.resize(nWords_);
+
+  auto accepts = [this](const std::vector<Word>& set) {
+    for(size_t w = 0; w < nWords_; w++) {
+      if(set[w] & acceptMask_[w]) return true;
+    }
+    return false;
+  };
+
+  std::fill(curr.begin(), curr.end(), 0);
+  curr[0] = 1;
+  long longestMatch = -1;
+  if(accepts(curr)) {
+    if(unanchored) return 0;
+    longestMatch = 0;
+  }
+  for(long counter = 0; counter < length; counter++) {
+    if(unanchored) curr[0] |= 1;
+    Word carry = 0;
+    for(size_t w = 0; w < nWords_; w++) {
+      next[w] = ((curr[w] << 1) | carry) & shiftMask_[w];
+      carry = curr[w] >> 63;
+    }
+    for(size_t slot = 0; slot < chunks_.size(); slot++) {
+      auto chunk = chunks_[slot];
+      auto value =
+          ((curr[chunk / 8] & otherMask_[chunk / 8]) >> (chunk % 8 * 8)) &
+          0xff;
+      if(!value) continue;
+      const Word* follow = &followTables_[(slot * 256 + value) * nWords_];
+      for(size_t w = 0; w < nWords_; w++)
+        next[w] |= follow[w];
+    }
+    const Word* mask = &byteMasks_[(unsigned char)input[counter] * nWords_];
+    Word any = 0;
+    for(size_t w = 0; w < nWords_; w++) {
+      next[w] &= mask[w];
+      any |= next[w];
+    }
+    std::swap(curr, next);
+    if(accepts(curr)) {
+      if(unanchored) return counter + 1;
+      longestMatch = counter + 1;
+    } else if(!any && !unanchored) {
+      break;
+    }
+  }
+  return longestMatch;
+}
+
+bool ShiftAnd::fasterThan(const DenseDFA& dfa) const {
+  // a step here is a chain of one table lookup per chunk, per word, where a
+  // dfa step is one lookup. measured on (a|b)*a(a|b){n}, a 5 lookup step only
+  // wins once the dfa table is around 4MB and most dfa steps miss L2
+  size_t lookups = nWords_ * (1 + chunks_.size());
+  return dfa.tableBytes() > lookups * (512 << 10);
+}
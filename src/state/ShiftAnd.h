@@ -0,0 +1,78 @@
+#ifndef OPAL_STATE_SHIFTAND_H_
+#define OPAL_STATE_SHIFTAND_H_
+
+#include "Automaton.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+class DenseDFA;
+class StateList;
+
+// simulates an NFA with one bit per state, updating the whole set of active
+// states with a few word operations per byte (Shift-And, extended to Glushkov
+// automata as in Navarro & Raffinot)
+// states are first split so every edge into a state has the same byte, then
+// the next set is follow(active) & mask[byte]. states are numbered depth first
+// so most edges go from bit i to bit i + 1 and are handled by one shift, the
+// rest are looked up 8 bits at a time in precomputed tables
+// sets past 64 states span several words, their scratch sets are kept per
+// thread so matching is const and thread safe
+class ShiftAnd {
+public:
+  using Word = uint64_t;
+
+private:
+  size_t nStates_ = 0;
+  size_t nWords_ = 0;
+  // states entered on byte c, [c * nWords_ + w]
+  std::vector<Word> byteMasks_;
+  // states entered from the state just before them
+  std::vector<Word> shiftMask_;
+  // states with an edge that isn't to the state just after them
+  std::vector<Word> otherMask_;
+  std::vector<Word> acceptMask_;
+  // the 8 bit chunks of `otherMask_` that aren't empty, and for each of them
+  // the states followed from every value of the chunk,
+  // [(slot * 256 + value) * nWords_ + w]
+  std::vector<uint32_t> chunks_;
+  std::vector<Word> followTables_;
+
+public:
+  // epsilon transitions are removed first
+  explicit ShiftAnd(const Automaton& nfa);
+  explicit ShiftAnd(const StateList& nfa)
+      : ShiftAnd(Automaton::fromStateList(nfa)) {}
+
+  // same contract as the generated matchers, the length of the longest prefix
+  // of input that matches or -1
+  long match(const char* input, long length) const;
+  long operator()(const char* input, long length) const {
+    return match(input, length);
+  }
+  // where the first match to end ends, or -1. the entry is added back to the
+  // active set before every byte, so a match can start anywhere
+  long earliestMatch(const char* input, long length) const;
+
+  // states after splitting, including the entry
+  size_t size() const { return nStates_; }
+  size_t words() const { return nWords_; }
+  size_t tableBytes() const {
+    return (byteMasks_.size() + followTables_.size()) * sizeof(Word);
+  }
+
+  // a guess at whether this runs faster than `dfa` for the same pattern
+  // a DFA step is a single load, so the DFA wins until its table is much
+  // larger than the cache
+  bool fasterThan(const DenseDFA& dfa) const;
+
+private:
+  // longest anchored match, or with `unanchored` the first match to end
+  long run(const char* input, long length, bool unanchored) const;
+  // the same with single word sets, which stay in registers
+  template <bool Unanchored>
+  long runOneWord(const char* input, long length) const;
+};
+
+#endif
@@ -0,0 +1,280 @@
+#include "ShuffleDFA.h"
+
+#include "DenseDFA.h"
+
+#include <algorithm>
+#include <cassert>
+#include <map>
+#include <sstream>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define OPAL_X86_SIMD
+#include <immintrin.h>
+#endif
+
+bool ShuffleDFA::fits(const DenseDFA& dfa) { return dfa.size() <= MaxStates; }
+
+bool ShuffleDFA::canRunNasm() {
+#ifdef OPAL_X86_SIMD
+  return __builtin_cpu_supports("ssse3");
+#else
+  return false;
+#endif
+}
+
+ShuffleDFA::ShuffleDFA(const Automaton& dfa)
+    : nStates_(dfa.size() + 1),
+      start_(uint8_t(dfa.entry() + 1)),
+      next_(256, Lanes{}) {
+  assert(dfa.isDFA() && fits(dfa));
+  if(dfa.hasPatterns()) patterns_.resize(nStates_);
+  for(Automaton::StateId s = 0; s < dfa.size(); s++) {
+    if(dfa.isAccept(s)) acceptMask_ |= uint16_t(1) << (s + 1);
+    if(dfa.hasPatterns()) patterns_[s + 1] = dfa.patterns(s);
+    for(const auto& e : dfa.edges(s))
+      next_[e.label][s + 1] = uint8_t(e.to + 1);
+  }
+#ifdef OPAL_X86_SIMD
+  hasSSSE3_ = __builtin_cpu_supports("ssse3");
+#endif
+}
+
+ShuffleDFA::ShuffleDFA(const DenseDFA& dfa)
+    : nStates_(dfa.size()),
+      start_(uint8_t(dfa.start() / dfa.stride())),
+      next_(256, Lanes{}) {
+  assert(fits(dfa));
+  for(size_t row = 1; row < nStates_; row++) {
+    auto s = DenseDFA::StateId(row * dfa.stride());
+    if(dfa.isAccept(s)) acceptMask_ |= uint16_t(1) << row;
+    for(size_t c = 0; c < 256; c++)
+      next_[c][row] = uint8_t(dfa.next(s, (unsigned char)c) / dfa.stride());
+  }
+#ifdef OPAL_X86_SIMD
+  hasSSSE3_ = __builtin_cpu_supports("ssse3");
+#endif
+}
+
+long ShuffleDFA::match(const char* input, long length) const {
+  return runLanes(input, length, uint16_t(1) << start_).lastAccept[start_];
+}
+
+ShuffleDFA::Map ShuffleDFA::run(const char* input, long length) const {
+  return runLanes(input, length, 0xffff);
+}
+
+ShuffleDFA::Map ShuffleDFA::compose(
+    const Map& first,
+    const Map& second,
+    long firstLength) {
+  Map map;
+  for(size_t lane = 0; lane < MaxStates; lane++) {
+    auto middle = first.end[lane];
+    map.end[lane] = second.end[middle];
+    long lastAccept = second.lastAccept[middle];
+    map.lastAccept[lane] =
+        lastAccept >= 0 ? firstLength + lastAccept : first.lastAccept[lane];
+  }
+  return map;
+}
+
+ShuffleDFA::Map ShuffleDFA::runScalar(
+    const char* input,
+    long length,
+    uint16_t watch) const {
+  Map map;
+  for(size_t lane = 0; lane < MaxStates; lane++) {
+    uint8_t s = uint8_t(lane);
+    long lastAccept = isAccept(s) ? 0 : -1;
+    if((watch >> lane) & 1) {
+      for(long counter = 0; counter < length && s != 0; counter++) {
+        s = next_[(unsigned char)input[counter]][s];
+        lastAccept = isAccept(s) ? counter + 1 : lastAccept;
+      }
+    }
+    map.end[lane] = s;
+    map.lastAccept[lane] = lastAccept;
+  }
+  return map;
+}
+
+#ifdef OPAL_X86_SIMD
+
+// every lane is moved by every byte, the watched ones are only checked for
+// being dead between blocks. within a block each lane's last accept is kept as
+// a byte, its offset in the block plus one
+__attribute__((target("ssse3"))) static void runShuffles(
+    const ShuffleDFA::Lanes* next,
+    uint16_t acceptMask,
+    const char* input,
+    long length,
+    uint16_t watch,
+    ShuffleDFA::Map& map) {
+  alignas(16) uint8_t accepts[ShuffleDFA::MaxStates];
+  for(size_t lane = 0; lane < ShuffleDFA::MaxStates; lane++)
+    accepts[lane] = (acceptMask >> lane) & 1 ? 0xff : 0;
+  const __m128i acceptLanes =
+      _mm_load_si128(reinterpret_cast<const __m128i*>(accepts));
+  const __m128i one = _mm_set1_epi8(1);
+  __m128i lanes =
+      _mm_setr_epi8(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15);
+
+  const long block = 64;
+  alignas(16) uint8_t lasts[ShuffleDFA::MaxStates];
+  for(long pos = 0; pos < length; pos += block) {
+    long stop = std::min(length, pos + block);
+    __m128i last = _mm_setzero_si128();
+    __m128i offset = _mm_setzero_si128();
+    for(long i = pos; i < stop; i++) {
+      __m128i row = _mm_loadu_si128(
+          reinterpret_cast<const __m128i*>(&next[(unsigned char)input[i]]));
+      lanes = _mm_shuffle_epi8(row, lanes);
+      offset = _mm_add_epi8(offset, one);
+      __m128i accepted = _mm_shuffle_epi8(acceptLanes, lanes);
+      last = _mm_or_si128(
+          _mm_and_si128(accepted, offset),
+          _mm_andnot_si128(accepted, last));
+    }
+
+    _mm_store_si128(reinterpret_cast<__m128i*>(lasts), last);
+    for(size_t lane = 0; lane < ShuffleDFA::MaxStates; lane++) {
+      if(lasts[lane]) map.lastAccept[lane] = pos + lasts[lane];
+    }
+    auto dead = uint16_t(
+        _mm_movemask_epi8(_mm_cmpeq_epi8(lanes, _mm_setzero_si128())));
+    if((dead & watch) == watch) break;
+  }
+  _mm_storeu_si128(reinterpret_cast<__m128i*>(map.end.data()), lanes);
+}
+
+ShuffleDFA::Map ShuffleDFA::runSSSE3(
+    const char* input,
+    long length,
+    uint16_t watch) const {
+  Map map;
+  for(size_t lane = 0; lane < MaxStates; lane++) {
+    map.end[lane] = uint8_t(lane);
+    map.lastAccept[lane] = isAccept(uint8_t(lane)) ? 0 : -1;
+  }
+  runShuffles(next_.data(), acceptMask_, input, length, watch, map);
+  return map;
+}
+
+#else
+
+ShuffleDFA::Map ShuffleDFA::runSSSE3(
+    const char* input,
+    long length,
+    uint16_t watch) const {
+  return runScalar(input, length, watch);
+}
+
+#endif
+
+std::vector<std::vector<Automaton::PatternId>> ShuffleDFA::patternSets(
+    std::vector<size_t>& setOf) const {
+  // set 0 is empty, the others are numbered as they are first seen
+  std::vector<std::vector<Automaton::PatternId>> sets(1);
+  std::map<std::vector<Automaton::PatternId>, size_t> ids = {{{}, 0}};
+  setOf.assign(MaxStates, 0);
+  for(size_t s = 0; s < patterns_.size(); s++) {
+    if(!isAccept(uint8_t(s))) continue;
+    auto [it, inserted] = ids.emplace(patterns_[s], sets.size());
+    if(inserted) sets.push_back(patterns_[s]);
+    setOf[s] = it->second;
+  }
+  return sets;
+}
+
+std::string ShuffleDFA::toNasm(const std::string& name) const {
+  std::stringstream ss;
+  ss << "bits 64\n";
+  ss << "section .rodata\n";
+  ss << "align 16\n";
+  ss << name << "_next:\n";
+  for(const auto& row : next_) {
+    ss << "  db ";
+    for(size_t lane = 0; lane < MaxStates; lane++)
+      ss << (lane ? ", " : "") << unsigned(row[lane]);
+    ss << "\n";
+  }
+  ss << name << "_identity:\n";
+  ss << "  db 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15\n";
+  if(reportsPatterns()) {
+    std::vector<size_t> setOf;
+    patternSets(setOf);
+    ss << name << "_stateSets:\n";
+    ss << "  dq ";
+    for(size_t s = 0; s < MaxStates; s++)
+      ss << (s ? ", " : "") << setOf[s];
+    ss << "\n";
+  }
+
+  // rdi is the input, rsi its length, rdx the matched set. xmm0 holds the
+  // lanes, only lane `start_` is read back, into r10 through xmm2. r9 is the
+  // state of the longest match
+  ss << "section .text\n";
+  ss << "global " << name << "\n";
+  ss << name << ":\n";
+  ss << "  movdqa xmm0, [rel " << name << "_identity]\n";
+  ss << "  lea r8, [rel " << name << "_next]\n";
+  ss << "  mov r11d, " << acceptMask_ << "\n";
+  ss << "  mov rax, " << (isAccept(start_) ? 0 : -1) << "\n";
+  ss << "  mov r9d, " << unsigned(start_) << "\n";
+  ss << "  xor ecx, ecx\n";
+  ss << "." << name << "_loop:\n";
+  ss << "  cmp rcx, rsi\n";
+  ss << "  jge ." << name << "_done\n";
+  ss << "  movzx r10d, byte [rdi + rcx]\n";
+  ss << "  shl r10d, 4\n";
+  ss << "  movdqa xmm1, [r8 + r10]\n";
+  ss << "  pshufb xmm1, xmm0\n";
+  ss << "  movdqa xmm0, xmm1\n";
+  ss << "  inc rcx\n";
+  // lane `start_` to the bottom and out, sse2 has no byte extract
+  ss << "  movdqa xmm2, xmm0\n";
+  if(start_ != 0) ss << "  psrldq xmm2, " << unsigned(start_) << "\n";
+  ss << "  movd r10d, xmm2\n";
+  ss << "  movzx r10d, r10b\n";
+  ss << "  test r10d, r10d\n";
+  ss << "  jz ." << name << "_done\n";
+  ss << "  bt r11d, r10d\n";
+  ss << "  cmovc rax, rcx\n";
+  ss << "  cmovc r9d, r10d\n";
+  ss << "  jmp ." << name << "_loop\n";
+  ss << "." << name << "_done:\n";
+  if(reportsPatterns()) {
+    ss << "  lea r10, [rel " << name << "_stateSets]\n";
+    ss << "  mov r10, [r10 + r9 * 8]\n";
+    ss << "  mov [rdx], r10\n";
+  }
+  ss << "  ret\n";
+  return ss.str();
+}
+
+std::string ShuffleDFA::toHeader(const std::string& name) const {
+  if(!reportsPatterns())
+    return "long " + name + "(const char* input, long length);";
+  return "long " + name +
+         "(const char* input, long length, long* matchedSet);\n"
+         "extern const long* const " +
+         name + "_sets[];\nextern const long " + name + "_nSets;";
+}
+
+std::string ShuffleDFA::toPatternSets(const std::string& name) const {
+  std::vector<size_t> setOf;
+  auto sets = patternSets(setOf);
+  std::stringstream ss;
+  for(size_t i = 0; i < sets.size(); i++) {
+    ss << "static const long " << name << "_set" << i << "[] = {";
+    for(auto p : sets[i])
+      ss << p << ", ";
+    ss << "-1};\n";
+  }
+  ss << "const long* const " << name << "_sets[] = {\n";
+  for(size_t i = 0; i < sets.size(); i++)
+    ss << name << "_set" << i << ",\n";
+  ss << "};\n";
+  ss << "const long " << name << "_nSets = " << sets.size() << ";";
+  return ss.str();
+}
@@ -0,0 +1,101 @@
+#ifndef OPAL_STATE_SHUFFLEDFA_H_
+#define OPAL_STATE_SHUFFLEDFA_H_
+
+#include "Automaton.h"
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+class DenseDFA;
+class StateList;
+
+// runs a DFA of at most 16 states, the dead state included, from every state
+// at once (the simultaneous DFA of Mytkowicz et al.)
+// lane i of a 16 byte vector holds where the run that started in state i is.
+// the transitions on one byte fit in one vector too, entry i being the state i
+// goes to, so one pshufb of that vector by the lanes moves every run a byte
+// states are numbered like DenseDFA rows, 0 is dead and dfa state s is s + 1
+class ShuffleDFA {
+public:
+  static constexpr size_t MaxStates = 16;
+  using Lanes = std::array<uint8_t, MaxStates>;
+
+  // what running some input from every state did, indexed by the start state
+  struct Map {
+    // where each run ended up
+    Lanes end;
+    // the end of each run's last accept, -1 when there wasn't one
+    std::array<long, MaxStates> lastAccept;
+  };
+
+private:
+  size_t nStates_ = 0;
+  uint8_t start_ = 0;
+  // the next state of every state on byte c, [c]
+  std::vector<Lanes> next_;
+  uint16_t acceptMask_ = 0;
+  // the patterns of each state, empty unless built from an automaton that has
+  // them
+  std::vector<std::vector<Automaton::PatternId>> patterns_;
+  bool hasSSSE3_ = false;
+
+public:
+  // whether `dfa` has few enough states
+  static bool fits(const Automaton& dfa) { return dfa.size() < MaxStates; }
+  static bool fits(const DenseDFA& dfa);
+
+  // `dfa` must be a DFA that fits
+  explicit ShuffleDFA(const Automaton& dfa);
+  explicit ShuffleDFA(const StateList& dfa)
+      : ShuffleDFA(Automaton::fromStateList(dfa)) {}
+  explicit ShuffleDFA(const DenseDFA& dfa);
+
+  // same contract as the generated matchers, the length of the longest prefix
+  // of input that matches or -1
+  long match(const char* input, long length) const;
+  long operator()(const char* input, long length) const {
+    return match(input, length);
+  }
+
+  // runs input from every state. maps of consecutive pieces of input compose,
+  // so pieces can run on different threads without knowing where the piece
+  // before them ends
+  Map run(const char* input, long length) const;
+  // the map of `first` followed by `second`, where `first` ran over
+  // `firstLength` bytes
+  static Map compose(const Map& first, const Map& second, long firstLength);
+
+  // asm for a matcher with the same contract as CompiledRegex::toNasm, one
+  // shuffle per byte instead of a branch per edge. pshufb needs SSSE3
+  std::string toNasm(const std::string& name) const;
+  // whether this machine can run toNasm
+  static bool canRunNasm();
+  std::string toHeader(const std::string& name) const;
+  std::string toPatternSets(const std::string& name) const;
+
+  uint8_t start() const { return start_; }
+  uint8_t next(uint8_t s, unsigned char c) const { return next_[c][s]; }
+  bool isAccept(uint8_t s) const { return (acceptMask_ >> s) & 1; }
+  // includes the dead state
+  size_t size() const { return nStates_; }
+  bool reportsPatterns() const { return !patterns_.empty(); }
+
+private:
+  // runs the lanes in `watch` until they are all dead or the input ends, and
+  // returns the other lanes wherever they were then
+  Map runScalar(const char* input, long length, uint16_t watch) const;
+  Map runSSSE3(const char* input, long length, uint16_t watch) const;
+  Map runLanes(const char* input, long length, uint16_t watch) const {
+    return hasSSSE3_ ? runSSSE3(input, length, watch)
+                     : runScalar(input, length, watch);
+  }
+  // pattern sets in the order CompiledRegex would number them, and the set of
+  // each state
+  std::vector<std::vector<Automaton::PatternId>> patternSets(
+      std::vector<size_t>& setOf) const;
+};
+
+#endif
@@ -0,0 +1,100 @@
+#ifndef OPAL_STATE_STATESET_H_
+#define OPAL_STATE_STATESET_H_
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+// a set of densely numbered states, stored as a bitset
+// all sets that are compared or combined must be built with the same size
+class StateSet {
+private:
+  using Word = uint64_t;
+  static constexpr size_t WordBits = 64;
+  std::vector<Word> words_;
+
+public:
+  StateSet() = default;
+  explicit StateSet(size_t nStates)
+      : words_((nStates + WordBits - 1) / WordBits, 0) {}
+
+  void insert(size_t i) { words_[i / WordBits] |= Word(1) << (i % WordBits); }
+  bool contains(size_t i) const {
+    return (words_[i / WordBits] >> (i % WordBits)) & 1;
+  }
+  bool empty() const {
+    for(auto w : words_) {
+      if(w) return false;
+    }
+    return true;
+  }
+  size_t size() const {
+    size_t n = 0;
+    for(auto w : words_)
+      n += __builtin_popcountll(w);
+    return n;
+  }
+  void clear() { std::fill(words_.begin(), words_.end(), 0); }
+
+  // or all of `other` into this set
+  void unionWith(const StateSet& other) {
+    size_t i = 0;
+    size_t n = words_.size();
+    Word* dst = words_.data();
+    const Word* src = other.words_.data();
+#ifdef __SSE2__
+    for(; i + 2 <= n; i += 2) {
+      __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(dst + i));
+      __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), _mm_or_si128(a, b));
+    }
+#endif
+    for(; i < n; i++)
+      dst[i] |= src[i];
+  }
+
+  // calls `func` with the index of every state in the set, in increasing order
+  template <class Func> void forEach(Func func) const {
+    for(size_t w = 0; w < words_.size(); w++) {
+      Word bits = words_[w];
+      while(bits) {
+        func(w * WordBits + __builtin_ctzll(bits));
+        bits &= bits - 1;
+      }
+    }
+  }
+
+  size_t hash() const {
+    // word at a time multiply-xorshift, good enough to spread sparse sets
+    uint64_t h = 0x9E3779B97F4A7C15ULL ^ words_.size();
+    for(auto w : words_) {
+      h ^= w;
+      h *= 0xFF51AFD7ED558CCDULL;
+      h ^= h >> 32;
+    }
+    return size_t(h);
+  }
+
+  friend bool operator==(const StateSet& lhs, const StateSet& rhs) {
+    return lhs.words_.size() == rhs.words_.size() &&
+           std::memcmp(
+               lhs.words_.data(),
+               rhs.words_.data(),
+               lhs.words_.size() * sizeof(Word)) == 0;
+  }
+  friend bool operator!=(const StateSet& lhs, const StateSet& rhs) {
+    return !(lhs == rhs);
+  }
+
+  struct Hash {
+    size_t operator()(const StateSet& s) const { return s.hash(); }
+  };
+};
+
+#endif
@@ -0,0 +1,201 @@
+#include "checks.h"
+
+#include "codegen/Instruction.h"
+#include "codegen/JITRegex.h"
+#include "parser/parse_regex.h"
+#include "state/DFAImage.h"
+#include "state/DenseDFA.h"
+
+#include <iostream>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+static Automaton minimalDFA(const Automaton& nfa) {
+  return nfa.buildDFA().prune().minimize();
+}
+
+// toBytes of register to register instructions, against what nasm makes of
+// their toNasm. the byte forms have their own opcodes
+static size_t checkEncodings() {
+  struct Case {
+    Types type;
+    X86Register dest;
+    X86Register source;
+    std::vector<unsigned char> copy, add, sub, cmp;
+  };
+  const std::vector<Case> cases = {
+      {Types::CHAR,
+       X86Register::C,
+       X86Register::D,
+       {0x88, 0xD1},
+       {0x00, 0xD1},
+       {0x28, 0xD1},
+       {0x38, 0xD1}},
+      // sil and dil need a rex prefix, without one they are dh and bh
+      {Types::CHAR,
+       X86Register::DI,
+       X86Register::SI,
+       {0x40, 0x88, 0xF7},
+       {0x40, 0x00, 0xF7},
+       {0x40, 0x28, 0xF7},
+       {0x40, 0x38, 0xF7}},
+      {Types::CHAR,
+       X86Register::R8,
+       X86Register::A,
+       {0x41, 0x88, 0xC0},
+       {0x41, 0x00, 0xC0},
+       {0x41, 0x28, 0xC0},
+       {0x41, 0x38, 0xC0}},
+      {Types::INT,
+       X86Register::A,
+       X86Register::C,
+       {0x89, 0xC8},
+       {0x01, 0xC8},
+       {0x29, 0xC8},
+       {0x39, 0xC8}},
+      {Types::LONG,
+       X86Register::R9,
+       X86Register::A,
+       {0x49, 0x89, 0xC1},
+       {0x49, 0x01, 0xC1},
+       {0x49, 0x29, 0xC1},
+       {0x49, 0x39, 0xC1}},
+  };
+
+  size_t failures = 0;
+  auto expect = [&](Instruction& ins, const std::vector<unsigned char>& want) {
+    auto got = ins.toBytes();
+    if(got == want) return;
+    failures++;
+    std::cout << "encoding: '" << ins.toNasm() << "' gave";
+    for(auto b : got)
+      std::cout << " " << std::hex << int(b) << std::dec;
+    std::cout << "\n";
+  };
+  for(const auto& c : cases) {
+    auto dest = Variable::buildLocal(c.type, "dest", c.dest);
+    auto source = Variable::buildLocal(c.type, "source", c.source);
+    Copy copy;
+    copy.dest = dest.get();
+    copy.source = source.get();
+    expect(copy, c.copy);
+    Add add;
+    add.dest = dest.get();
+    add.op1 = source.get();
+    expect(add, c.add);
+    Sub sub;
+    sub.dest = dest.get();
+    sub.op1 = source.get();
+    expect(sub, c.sub);
+    NOP target;
+    ConditionalJump cmp;
+    cmp.lhs = dest.get();
+    cmp.rhs = source.get();
+    cmp.cc = ConditionCode::EQ;
+    cmp.target = &target;
+    // followed by a je whose displacement is filled in later
+    auto cmpJe = c.cmp;
+    cmpJe.insert(cmpJe.end(), {0x0F, 0x84, 0, 0, 0, 0});
+    expect(cmp, cmpJe);
+  }
+  std::cout << "encoding: " << cases.size() * 4 << " cases, " << failures
+            << " failed\n";
+  return failures;
+}
+
+// prints the first ten failures
+static void report(
+    size_t& failures,
+    const char* what,
+    const std::string& pattern,
+    const std::string& input,
+    long got,
+    long want) {
+  if(failures++ >= 10) return;
+  std::cout << "jit: " << what << " '" << pattern << "' on '" << input
+            << "' gave " << got << " instead of " << want << "\n";
+}
+
+// the native code of every match mode finds what the table does, and reports
+// the same pattern set as a DFAImage of the same DFA
+size_t checkJIT() {
+  size_t encodingFailures = checkEncodings();
+
+  const std::vector<std::vector<std::string>> sets = {
+      {"(a).(b)", "((a)*).(c)", "(((b)|(c))*).(d)"},
+      {"((a).(b))*"},
+      {"(a).((b)*)", "(b).(a)"},
+      {"((((a)|(b))*).(a)).(((a)|(b)).((a)|(b)))"},
+      {"(((s).(u)).(((p).(p)).((e).(r))))|(((a).(c)).(e))", "(s).(u)"},
+      {"_"},
+  };
+
+  std::mt19937 rng(1);
+  std::vector<std::string> inputs = {"", "bcdd", "super", "ace", "\xff\x80"};
+  for(int i = 0; i < 500; i++) {
+    std::string input;
+    for(size_t length = rng() % 24; input.size() < length;)
+      input += "abcdepsrux\xff"[rng() % 11];
+    inputs.push_back(input);
+  }
+
+  size_t cases = 0;
+  size_t failures = 0;
+  for(const auto& set : sets) {
+    Parser parser;
+    std::vector<Automaton> automata;
+    for(const auto& pattern : set)
+      automata.push_back(*parser.parseAutomaton(pattern));
+    auto nfa = Automaton::unionOf(automata);
+    auto dfa = minimalDFA(nfa);
+    auto forward = minimalDFA(nfa.unanchored());
+    auto reverse = minimalDFA(nfa.reversed());
+    DenseDFA dense(dfa);
+    DenseDFA denseForward(forward);
+    DenseDFA denseReverse(reverse);
+    auto image = DFAImage::build(dfa);
+    auto loaded = DFAImage::load(image.data(), image.size());
+
+    auto compiled = dfa.compile();
+    auto compiledForward = forward.compile(MatchMode::Earliest);
+    auto compiledReverse = reverse.compile(MatchMode::Reverse);
+    auto jit = JITRegex::compile(compiled);
+    auto jitForward = JITRegex::compile(compiledForward);
+    auto jitReverse = JITRegex::compile(compiledReverse);
+    if(!jit || !jitForward || !jitReverse) {
+      std::cout << "jit: no native code on this machine\n";
+      return encodingFailures;
+    }
+
+    const auto& name = set.front();
+    for(const auto& input : inputs) {
+      cases++;
+      const char* data = input.data();
+      long length = long(input.size());
+      long matchedSet = 0;
+      size_t wantSet = 0;
+      long got = jit->match(data, length, &matchedSet);
+      long want = loaded->match(data, length, &wantSet);
+      if(got != want || got != dense.match(data, length))
+        report(failures, "longest", name, input, got, want);
+      else if(jit->reportsPatterns() &&
+              jit->patterns(size_t(matchedSet)) !=
+                  std::vector<uint32_t>(
+                      loaded->setBegin(wantSet),
+                      loaded->setEnd(wantSet)))
+        report(failures, "set", name, input, matchedSet, long(wantSet));
+      got = jitForward->match(data, length);
+      want = denseForward.earliestMatch(data, length);
+      if(got != want)
+        report(failures, "earliest", name, input, got, want);
+      got = jitReverse->match(data, length);
+      want = denseReverse.reverseMatch(data, length);
+      if(got != want)
+        report(failures, "reverse", name, input, got, want);
+    }
+  }
+  std::cout << "jit: " << cases << " cases, " << failures << " failed\n";
+  return encodingFailures + failures;
+}
@@ -0,0 +1,78 @@
+#include "checks.h"
+
+#include "common/ThreadPool.h"
+#include "parser/parse_regex.h"
+#include "state/DenseDFA.h"
+#include "state/ParallelDFA.h"
+#include "state/ShuffleDFA.h"
+
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+// chunks after the first start from every state and are chained afterwards,
+// so a match that crosses chunks or an accept that only some of the runs
+// reach is where the merging can go wrong
+size_t checkParallel() {
+  const std::vector<std::vector<std::string>> sets = {
+      // small enough for the shuffle path
+      {"((a).(b))*"},
+      {"(a).((b)*)", "(b).(a)"},
+      {"(((a)|(b))*).(c)"},
+      // 16 states or more, every state is run on its own
+      {"((((a)|(b))*).(a)).(((a)|(b)).(((a)|(b)).((a)|(b))))"},
+      {"((((a)|(b))*).(b)).(((a)|(b)).(((a)|(b)).(((a)|(b)).((a)|(b)))))",
+       "(((c)|(a))*).(d)"},
+  };
+  const std::vector<size_t> chunkCounts = {1, 2, 3, 5, 8};
+
+  std::mt19937 rng(1);
+  std::vector<std::string> inputs = {"", "a", "ab", "abababababababab"};
+  for(int i = 0; i < 300; i++) {
+    std::string input;
+    for(size_t length = rng() % 64; input.size() < length;)
+      input += "abcd"[rng() % (i % 2 ? 2 : 4)];
+    inputs.push_back(input);
+  }
+  // long enough that every chunk runs for a while
+  for(int i = 0; i < 4; i++) {
+    std::string input;
+    while(input.size() < 4096)
+      input += "ab"[rng() % 2];
+    inputs.push_back(input);
+  }
+
+  common::ThreadPool pool(4);
+  size_t failures = 0;
+  size_t cases = 0;
+  size_t shuffled = 0;
+  for(const auto& set : sets) {
+    Parser parser;
+    std::vector<Automaton> automata;
+    for(const auto& pattern : set)
+      automata.push_back(*parser.parseAutomaton(pattern));
+    auto nfa = Automaton::unionOf(automata);
+    DenseDFA dense(nfa.buildDFA().prune().minimize());
+    if(ShuffleDFA::fits(dense)) shuffled++;
+
+    for(auto nChunks : chunkCounts) {
+      ParallelDFA parallel(dense, pool, nChunks);
+      for(const auto& input : inputs) {
+        cases++;
+        long got = parallel.match(input.data(), long(input.size()));
+        long want = dense.match(input.data(), long(input.size()));
+        if(got == want) continue;
+        if(failures++ < 10) {
+          std::cout << "parallel: '" << set.front() << "' in " << nChunks
+                    << " chunks on " << input.size() << " bytes gave " << got
+                    << " instead of " << want << "\n";
+        }
+      }
+    }
+  }
+  std::cout << "parallel: " << cases << " cases over " << sets.size()
+            << " DFAs, " << shuffled << " shuffled, " << failures
+            << " failed\n";
+  return failures;
+}
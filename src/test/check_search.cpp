@@ -0,0 +1,61 @@
+#include "checks.h"
+
+#include "parser/parse_regex.h"
+#include "state/DenseDFA.h"
+#include "state/Searcher.h"
+
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+// DenseDFA::search runs the anchored DFA from every offset that can start a
+// match, so it finds the leftmost longest match by construction
+size_t checkSearch() {
+  const std::vector<std::vector<std::string>> sets = {
+      // ab, a*c and (b|c)*d, on bcdd the leftmost match is bcd and not c
+      {"(a).(b)", "((a)*).(c)", "(((b)|(c))*).(d)"},
+      {"((a).(b))*"},
+      {"(a).((b)*)", "(b).(a)"},
+      {"((a)|(b)).(((a)|(b)).(c))"},
+      {"(((a)|(b))*).(((c).(d))|(d))", "(b).(c)"},
+      {"_"},
+  };
+
+  std::mt19937 rng(1);
+  size_t failures = 0;
+  size_t cases = 0;
+  for(const auto& set : sets) {
+    Parser parser;
+    std::vector<Automaton> automata;
+    for(const auto& pattern : set)
+      automata.push_back(*parser.parseAutomaton(pattern));
+    auto nfa = Automaton::unionOf(automata);
+    Searcher searcher(nfa);
+    DenseDFA dense(nfa.buildDFA().prune().minimize());
+
+    std::vector<std::string> inputs = {"", "bcdd", "xxabxx", "ccd"};
+    for(int i = 0; i < 500; i++) {
+      std::string input;
+      for(size_t length = rng() % 16; input.size() < length;)
+        input += "abcdx"[rng() % 5];
+      inputs.push_back(input);
+    }
+
+    for(const auto& input : inputs) {
+      cases++;
+      auto got = searcher.search(input.data(), long(input.size()));
+      auto want = dense.search(input.data(), long(input.size()));
+      if(got.start == want.start && got.end == want.end) continue;
+      if(failures++ < 10) {
+        std::cout << "search: '" << set.front() << "'";
+        if(set.size() > 1) std::cout << " and " << set.size() - 1 << " more";
+        std::cout << " on '" << input << "' found [" << got.start << ", "
+                  << got.end << ") instead of [" << want.start << ", "
+                  << want.end << ")\n";
+      }
+    }
+  }
+  std::cout << "search: " << cases << " cases, " << failures << " failed\n";
+  return failures;
+}
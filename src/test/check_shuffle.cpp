@@ -0,0 +1,158 @@
+#include "checks.h"
+
+#include "parser/parse_regex.h"
+#include "state/DFAImage.h"
+#include "state/DenseDFA.h"
+#include "state/ShuffleDFA.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+static Automaton minimalDFA(const Automaton& nfa) {
+  return nfa.buildDFA().prune().minimize();
+}
+
+// a program that runs the matcher on every input and prints the length of
+// the match, followed by the patterns of its set when it reports them, one
+// line per input
+static std::string driverC(
+    const ShuffleDFA& shuffle,
+    const std::vector<std::string>& inputs) {
+  std::stringstream ss;
+  ss << "#include <stdio.h>\n";
+  ss << shuffle.toHeader("match") << "\n";
+  ss << shuffle.toPatternSets("match") << "\n";
+  ss << "static const char* inputs[] = {\n";
+  for(const auto& input : inputs) {
+    ss << "\"";
+    for(unsigned char c : input) {
+      char hex[5];
+      std::snprintf(hex, sizeof(hex), "\\x%02x", c);
+      ss << hex;
+    }
+    ss << "\",\n";
+  }
+  ss << "};\n";
+  ss << "static const long lengths[] = {";
+  for(const auto& input : inputs)
+    ss << input.size() << ", ";
+  ss << "};\n";
+  ss << "int main(void) {\n"
+     << "  for(long i = 0; i < " << inputs.size() << "; i++) {\n";
+  if(shuffle.reportsPatterns()) {
+    ss << "    long set = 0;\n"
+       << "    printf(\"%ld\", match(inputs[i], lengths[i], &set));\n"
+       << "    for(const long* p = match_sets[set]; *p >= 0; p++)\n"
+       << "      printf(\" %ld\", *p);\n";
+  } else ss << "    printf(\"%ld\", match(inputs[i], lengths[i]));\n";
+  ss << "    printf(\"\\n\");\n"
+     << "  }\n"
+     << "  return 0;\n"
+     << "}\n";
+  return ss.str();
+}
+
+// ShuffleDFA::toNasm is what matcher-builder writes for small DFAs, so it is
+// assembled and linked the same way, under testing/bin, and run against
+// DenseDFA and the pattern sets of a DFAImage. skipped without nasm and clang
+// or on a machine that can't run it
+size_t checkShuffle() {
+  if(!ShuffleDFA::canRunNasm()) {
+    std::cout << "shuffle: no SSSE3, skipped\n";
+    return 0;
+  }
+  if(std::system("nasm -v > /dev/null 2>&1") != 0 ||
+     std::system("clang -v > /dev/null 2>&1") != 0) {
+    std::cout << "shuffle: no nasm or clang, skipped\n";
+    return 0;
+  }
+  std::system("mkdir -p testing/bin");
+
+  // one pattern reports nothing, several report the set that matched
+  const std::vector<std::vector<std::string>> sets = {
+      {"((a).(b))*"},
+      {"(a).((b)*)"},
+      {"(((a)|(b))*).(c)"},
+      {"(a).(b)", "(a)|(b)", "(a)*"},
+      {"((a).((b)*)).(c)", "(b).(a)"},
+  };
+
+  std::mt19937 rng(1);
+  std::vector<std::string> inputs = {"", "a", "ab", "abab", "bac", "\xff"};
+  for(int i = 0; i < 200; i++) {
+    std::string input;
+    for(size_t length = rng() % 16; input.size() < length;)
+      input += "abcx\xff"[rng() % 5];
+    inputs.push_back(input);
+  }
+
+  size_t failures = 0;
+  size_t cases = 0;
+  for(const auto& set : sets) {
+    Parser parser;
+    std::vector<Automaton> automata;
+    for(const auto& pattern : set)
+      automata.push_back(*parser.parseAutomaton(pattern));
+    auto dfa = minimalDFA(
+        set.size() == 1 ? automata.front() : Automaton::unionOf(automata));
+    const auto& name = set.front();
+    if(!ShuffleDFA::fits(dfa)) {
+      std::cout << "shuffle: '" << name << "' doesn't fit\n";
+      failures++;
+      continue;
+    }
+    ShuffleDFA shuffle(dfa);
+    DenseDFA dense(dfa);
+    auto image = DFAImage::build(dfa);
+    auto loaded = DFAImage::load(image.data(), image.size());
+
+    std::ofstream("testing/bin/shuffle.asm") << shuffle.toNasm("match");
+    std::ofstream("testing/bin/shuffle.c") << driverC(shuffle, inputs);
+    if(std::system(
+           "nasm -felf64 testing/bin/shuffle.asm -o testing/bin/shuffle.o") !=
+           0 ||
+       std::system(
+           "clang testing/bin/shuffle.c testing/bin/shuffle.o "
+           "-o testing/bin/shuffle") != 0) {
+      std::cout << "shuffle: '" << name << "' didn't build\n";
+      failures++;
+      continue;
+    }
+
+    FILE* out = popen("testing/bin/shuffle", "r");
+    if(!out) {
+      std::cout << "shuffle: '" << name << "' didn't run\n";
+      failures++;
+      continue;
+    }
+    char line[256];
+    for(const auto& input : inputs) {
+      cases++;
+      std::string got = std::fgets(line, sizeof(line), out) ? line : "";
+      size_t wantSet = 0;
+      long length = long(input.size());
+      long m = loaded->match(input.data(), length, &wantSet);
+      std::string want = std::to_string(m);
+      if(shuffle.reportsPatterns()) {
+        for(auto p = loaded->setBegin(wantSet); p != loaded->setEnd(wantSet);
+            p++)
+          want += " " + std::to_string(*p);
+      }
+      want += "\n";
+      if(got == want && m == dense.match(input.data(), length)) continue;
+      if(failures++ < 10) {
+        std::cout << "shuffle: '" << name << "' on " << input.size()
+                  << " bytes gave " << got << " instead of " << want;
+      }
+    }
+    pclose(out);
+  }
+  std::cout << "shuffle: " << cases << " cases, " << failures << " failed\n";
+  return failures;
+}
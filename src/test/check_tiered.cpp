@@ -0,0 +1,129 @@
+#include "checks.h"
+
+#include "codegen/JITRegex.h"
+#include "common/ThreadPool.h"
+#include "parser/parse_regex.h"
+#include "pipeline/TieredMatcher.h"
+#include "state/DenseDFA.h"
+
+#include <atomic>
+#include <iostream>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+static const char* engineName(TieredMatcher::Engine engine) {
+  switch(engine) {
+  case TieredMatcher::Engine::PikeVM:
+    return "PikeVM";
+  case TieredMatcher::Engine::ShiftAnd:
+    return "ShiftAnd";
+  case TieredMatcher::Engine::JIT:
+    return "JIT";
+  case TieredMatcher::Engine::DenseDFA:
+    return "DenseDFA";
+  }
+  return "?";
+}
+
+// several threads match every pattern while it is promoted under them, so
+// calls run on the PikeVM, race the promotion and run on what it published.
+// afterwards each pattern has to be on the engine its DFA calls for
+size_t checkTiered() {
+  // (a|b)*a(a|b){17} has 2^18 DFA states, the fewest Shift-And beats
+  std::string ab = "(a)|(b)";
+  std::string big = "((" + ab + ")*).(a)";
+  for(int i = 0; i < 17; i++)
+    big = "(" + big + ").(" + ab + ")";
+  const std::vector<std::string> patterns = {
+      big, "((a).(b)).(c)", "(((a)|(b))*).(c)", "(a).((b)*)"};
+  // only matched a few times, never promoted
+  const std::string cold = "((c).(a))*";
+
+  TieredMatcher::Options options;
+  options.promoteAfterCalls = 500;
+  const size_t nThreads = 4;
+  const size_t callsPerThread = 1000;
+
+  std::vector<DenseDFA> dense;
+  std::vector<TieredMatcher::Engine> engines;
+  for(const auto& pattern : patterns) {
+    Parser parser;
+    auto dfa = parser.parseAutomaton(pattern)->buildDFA().prune().minimize();
+    dense.emplace_back(dfa);
+    if(pattern == big) {
+      engines.push_back(TieredMatcher::Engine::ShiftAnd);
+      continue;
+    }
+    // native code where this machine can map it, as TieredMatcher does
+    auto compiled = dfa.compile();
+    engines.push_back(
+        JITRegex::compile(compiled) ? TieredMatcher::Engine::JIT
+                                    : TieredMatcher::Engine::DenseDFA);
+  }
+  Parser parser;
+  DenseDFA denseCold(
+      parser.parseAutomaton(cold)->buildDFA().prune().minimize());
+
+  common::ThreadPool pool(2);
+  TieredMatcher matcher(pool, options);
+  for(const auto& pattern : patterns)
+    matcher.add(pattern);
+  auto coldId = *matcher.add(cold);
+
+  std::atomic<size_t> failures{0};
+  auto matchFromThreads = [&](unsigned seed) {
+    std::vector<std::thread> threads;
+    for(size_t t = 0; t < nThreads; t++) {
+      threads.emplace_back([&, t]() {
+        std::mt19937 rng(seed + unsigned(t));
+        for(size_t i = 0; i < callsPerThread; i++) {
+          std::string input;
+          for(size_t length = rng() % 40; input.size() < length;)
+            input += "abc"[rng() % (i % 4 ? 2 : 3)];
+          const char* data = input.data();
+          long length = long(input.size());
+          for(size_t p = 0; p < patterns.size(); p++) {
+            long got = matcher.match(p, data, length);
+            long want = dense[p].match(data, length);
+            if(got != want && failures++ < 10) {
+              std::cout << "tiered: pattern " << p << " on '" << input
+                        << "' gave " << got << " instead of " << want << "\n";
+            }
+          }
+          if(t != 0 || i >= 10) continue;
+          if(matcher.match(coldId, data, length) !=
+             denseCold.match(data, length))
+            failures++;
+        }
+      });
+    }
+    for(auto& thread : threads)
+      thread.join();
+  };
+  // promotions start partway through and may still be running at the end,
+  // so a second round makes sure every promoted engine is called
+  matchFromThreads(1);
+  matcher.waitForPromotions();
+  matchFromThreads(100);
+
+  size_t cases = 2 * (nThreads * callsPerThread * patterns.size() + 10);
+  auto expect = [&](size_t id, bool promoted, TieredMatcher::Engine engine) {
+    auto stats = matcher.stats(id);
+    if(stats.promoted == promoted && stats.engine == engine) return;
+    failures++;
+    std::cout << "tiered: pattern " << id << " is "
+              << (stats.promoted ? "" : "not ") << "promoted on "
+              << engineName(stats.engine) << ", should be "
+              << (promoted ? "" : "not ") << "promoted on "
+              << engineName(engine) << "\n";
+  };
+  for(size_t p = 0; p < patterns.size(); p++)
+    expect(p, true, engines[p]);
+  expect(coldId, false, TieredMatcher::Engine::PikeVM);
+  cases += patterns.size() + 1;
+
+  std::cout << "tiered: " << cases << " cases, " << failures << " failed\n";
+  return failures;
+}
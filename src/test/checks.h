@@ -0,0 +1,23 @@
+#ifndef OPAL_TEST_CHECKS_H_
+#define OPAL_TEST_CHECKS_H_
+
+#include <cstddef>
+
+// checks run by `test --check`, each prints what it got wrong and returns how
+// many cases failed
+
+// Searcher finds the same match as DenseDFA::search
+size_t checkSearch();
+// the JIT's machine code matches like DenseDFA, and its byte register
+// instructions encode as nasm would
+size_t checkJIT();
+// ParallelDFA::match agrees with DenseDFA::match for any number of chunks
+size_t checkParallel();
+// ShuffleDFA::toNasm, assembled and run, matches like DenseDFA. writes under
+// testing/bin
+size_t checkShuffle();
+// TieredMatcher matches like DenseDFA from several threads while patterns are
+// promoted, and ends up on the engine each pattern's DFA calls for
+size_t checkTiered();
+
+#endif
@@ -1,11 +1,24 @@
 
+#include "checks.h"
 #include "parser/parse_regex.h"
 #include "state/DFA.h"
 
 #include <fstream>
 #include <iostream>
-
-int main() {
+#include <string>
+
+int main(int argc, char** argv) {
+
+  // the checks compare engines with each other, only the shuffle check
+  // writes files, under testing/bin like the rest
+  if(argc > 1 && std::string(argv[1]) == "--check") {
+    size_t failures = checkSearch();
+    failures += checkJIT();
+    failures += checkParallel();
+    failures += checkShuffle();
+    failures += checkTiered();
+    return failures == 0 ? 0 : 1;
+  }
 
   // StateList sl;
 
@@ -106,6 +119,11 @@ int main() {
             << " states\n";
   dfa.prune();
   std::cout << "after pruning: " << dfa.states().size() << "\n";
+  if(dfa.isDFA()) {
+    auto stats = dfa.minimize();
+    std::cout << "after minimizing: " << stats.statesAfter << " (from "
+              << stats.statesBefore << ")\n";
+  }
 
   auto g3 = dfa.toGraph("g3");
   auto s3 = g3->toString();
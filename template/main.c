@@ -2,9 +2,10 @@
 #include <stdlib.h>
 #include <string.h>
 
-typedef long (*matchFunc)(const char*, long);
+extern int match_mayMatch(const char* input, long length);
+extern long match(const char* input, long length, long* matchedSet);
+extern const long* const match_sets[];
 extern long nPatterns;
-extern matchFunc funcs[];
 extern const char* patterns[];
 
 int main(int argc, const char** argv) {
@@ -14,15 +15,14 @@ int main(int argc, const char** argv) {
     const char* word = argv[i];
     long len = strlen(word);
 
-    long match = -1;
-    long funcNum;
-    for(funcNum = 0; funcNum < nPatterns; funcNum++) {
-      matchFunc f = funcs[funcNum];
-      match = f(word, len);
-      if(match >= 0 && match == len) break;
-    }
-    if(match >= 0 && match == len) {
-      printf("'%s' matched '%s'\n", word, patterns[funcNum]);
+    // one pass over the word, the set holds every pattern that matched the
+    // longest prefix
+    long set = 0;
+    long m = match_mayMatch(word, len) ? match(word, len, &set) : -1;
+    if(m >= 0 && m == len) {
+      for(const long* p = match_sets[set]; *p >= 0; p++) {
+        printf("'%s' matched '%s'\n", word, patterns[*p]);
+      }
     } else {
       printf("'%s' did not match anything\n", word);
     }